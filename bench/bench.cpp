@@ -0,0 +1,567 @@
+// Headless benchmark host
+// Runs each module's process() against scripted input signals, without the Rack engine or GUI
+// Reports average cost per sample, throughput, and the p99/worst case cost of a single process() call
+//
+// Usage: bench [-t seconds] [-n repeats] [-r sampleRate]... [scenario]...
+// With no scenarios given every scenario is run, with no rates given 44.1k, 48k, 96k and 192k are used
+// Throughput is the best of n runs of t seconds of audio, latency percentiles take each frame's best time over another n runs
+
+#include <rack.hpp>
+#include <chrono>
+
+using namespace rack;
+
+// Which ports and params a scenario touches, looked up by the names given in each module's config*() calls
+struct Rig
+{
+	Module *module = NULL;
+
+	int find(const std::vector<PortInfo *> &infos, const std::string &name)
+	{
+		for (size_t i = 0; i < infos.size(); ++i)
+		{
+			if (infos[i] && infos[i]->name == name)
+				return i;
+		}
+		std::fprintf(stderr, "No port named \"%s\"\n", name.c_str());
+		std::exit(1);
+	}
+
+	Input &input(const std::string &name)
+	{
+		return module->inputs[find(module->inputInfos, name)];
+	}
+
+	Param &param(const std::string &name)
+	{
+		for (size_t i = 0; i < module->paramQuantities.size(); ++i)
+		{
+			if (module->paramQuantities[i] && module->paramQuantities[i]->name == name)
+				return module->params[i];
+		}
+		std::fprintf(stderr, "No param named \"%s\"\n", name.c_str());
+		std::exit(1);
+	}
+
+	// Plug a cable into an input with the given number of channels
+	Input &connect(const std::string &name, int channels = 1)
+	{
+		Input &in = input(name);
+		in.channels = channels;
+		return in;
+	}
+
+	// Set one of the module's context menu options, by its key in dataToJson()
+	void option(const std::string &key, json_t *value)
+	{
+		json_t *rootJ = json_object();
+		json_object_set_new(rootJ, key.c_str(), value);
+		module->dataFromJson(rootJ);
+		json_decref(rootJ);
+	}
+
+	void option(const std::string &key, bool value)
+	{
+		option(key, json_boolean(value));
+	}
+
+	void option(const std::string &key, int value)
+	{
+		option(key, json_integer(value));
+	}
+
+	// Patch every output so modules that skip work for unpatched outputs do the full amount
+	void connectOutputs()
+	{
+		for (Output &out : module->outputs)
+			out.channels = 1;
+	}
+};
+
+// Scripted signals
+static float sine(int64_t frame, float sampleRate, float freq, float phase = 0.f)
+{
+	double t = std::fmod(frame * (double)freq / sampleRate + phase, 1.0);
+	return 5.f * std::sin(2.0 * M_PI * t);
+}
+
+// 10V for the first millisecond of each period
+static float pulse(int64_t frame, float sampleRate, float freq)
+{
+	int64_t period = std::max((int64_t)1, (int64_t)(sampleRate / freq));
+	return (frame % period) < (int64_t)(1e-3f * sampleRate) + 1 ? 10.f : 0.f;
+}
+
+// A single 1ms trigger at time t seconds
+static float once(int64_t frame, float sampleRate, float t)
+{
+	int64_t start = t * sampleRate;
+	return (frame >= start && frame <= start + (int64_t)(1e-3f * sampleRate)) ? 10.f : 0.f;
+}
+
+struct Scenario
+{
+	std::string name;
+	std::string slug;
+	std::function<void(Rig &)> setup;
+	std::function<void(Rig &, int64_t, float)> drive;
+};
+
+static std::vector<Scenario> scenarios()
+{
+	std::vector<Scenario> s;
+
+	// A single voice, then with its operators oversampled
+	for (int oversample : {1, 2, 4, 8})
+	{
+		s.push_back({oversample == 1 ? "PSIOP" : string::f("PSIOP-%dx", oversample), "PSIOP",
+					 [oversample](Rig &r) {
+						 r.connect("Trigger");
+						 r.connect("Accent Trigger");
+						 r.param("FM Algorithm").setValue(2.f);
+						 r.param("OP 1 Feedback").setValue(0.3f);
+						 r.param("Pitch Envelope Speed").setValue(0.6f);
+						 r.option("Oversampling", oversample);
+						 r.connectOutputs();
+					 },
+					 [](Rig &r, int64_t frame, float sampleRate) {
+						 r.input("Trigger").setVoltage(pulse(frame, sampleRate, 4.f));
+						 r.input("Accent Trigger").setVoltage(pulse(frame, sampleRate, 1.f));
+					 }});
+	}
+
+	// A 16 voice drum kit, each voice triggered at its own rate with its own pitch
+	// Then the same kit with repeated hits played back from the render cache
+	for (bool caching : {false, true})
+	{
+		s.push_back({caching ? "PSIOP-16-Cache" : "PSIOP-16", "PSIOP",
+					 [caching](Rig &r) {
+						 r.connect("Trigger", 16);
+						 r.connect("Accent Trigger", 16);
+						 r.connect("Start Freq CV", 16);
+						 r.param("FM Algorithm").setValue(2.f);
+						 r.param("OP 1 Feedback").setValue(0.3f);
+						 r.param("Pitch Envelope Speed").setValue(0.6f);
+						 r.option("Render Cache", caching);
+						 r.connectOutputs();
+					 },
+					 [](Rig &r, int64_t frame, float sampleRate) {
+						 for (int c = 0; c < 16; ++c)
+						 {
+							 r.input("Trigger").setVoltage(pulse(frame, sampleRate, 2.f + c * 0.25f), c);
+							 r.input("Accent Trigger").setVoltage(pulse(frame, sampleRate, 1.f), c);
+							 r.input("Start Freq CV").setVoltage(c / 8.f - 1.f, c);
+						 }
+					 }});
+	}
+
+	// Mono and 16 channels, then 16 channels through the crusher's anti-aliasing filter, and with each kind of dither
+	for (int setting = 0; setting < 5; ++setting)
+	{
+		static const char *names[5] = {"Planck-1", "Planck-16", "Planck-16-AA", "Planck-16-TPDF", "Planck-16-Shaped"};
+		int channels = (setting == 0) ? 1 : 16;
+		bool antiAliasing = (setting == 2);
+		int dither = std::max(setting - 2, 0);
+		s.push_back({names[setting], "Planck",
+					 [channels, antiAliasing, dither](Rig &r) {
+						 r.option("Anti-Aliasing", antiAliasing);
+						 r.option("Dither", dither);
+						 r.connect("Bit Depth Reducer", channels);
+						 r.param("Bit Depth Reduction").setValue(6.f);
+						 r.param("Sample Rate Decimation").setValue(20.f);
+						 r.connectOutputs();
+					 },
+					 [channels](Rig &r, int64_t frame, float sampleRate) {
+						 Input &in = r.input("Bit Depth Reducer");
+						 for (int c = 0; c < channels; ++c)
+							 in.setVoltage(sine(frame, sampleRate, 110.f * (c + 1)), c);
+					 }});
+	}
+
+	s.push_back({"Luigi", "Luigi",
+				 [](Rig &r) { r.connectOutputs(); },
+				 [](Rig &r, int64_t frame, float sampleRate) {}});
+
+	// Noise clocked at its fastest, mono then 16 channels
+	for (int channels : {1, 16})
+	{
+		s.push_back({string::f("Luigi-%d-Fast", channels), "Luigi",
+					 [channels](Rig &r) {
+						 r.param("Noise Generator Rate").setValue(12.f);
+						 r.option("Channels", channels);
+						 r.connectOutputs();
+					 },
+					 [](Rig &r, int64_t frame, float sampleRate) {}});
+	}
+
+	// 16 channels of each noise colour, at the default clock rate
+	for (int colour = 1; colour < 4; ++colour)
+	{
+		static const char *names[4] = {"", "Luigi-16-Pink", "Luigi-16-Brown", "Luigi-16-Velvet"};
+		s.push_back({names[colour], "Luigi",
+					 [colour](Rig &r) {
+						 r.option("Channels", 16);
+						 r.option("Noise Colour", colour);
+						 r.connectOutputs();
+					 },
+					 [](Rig &r, int64_t frame, float sampleRate) {}});
+	}
+
+	s.push_back({"Aspect", "Aspect",
+				 [](Rig &r) {
+					 r.connect("Trigger");
+					 r.connectOutputs();
+				 },
+				 [](Rig &r, int64_t frame, float sampleRate) {
+					 r.input("Trigger").setVoltage(pulse(frame, sampleRate, 8.f));
+				 }});
+
+	s.push_back({"Monte", "Monte",
+				 [](Rig &r) { r.connectOutputs(); },
+				 [](Rig &r, int64_t frame, float sampleRate) {}});
+
+	s.push_back({"Arpanet", "Arpanet",
+				 [](Rig &r) {
+					 r.connect("Start Trig");
+					 r.connectOutputs();
+				 },
+				 [](Rig &r, int64_t frame, float sampleRate) {
+					 r.input("Start Trig").setVoltage(once(frame, sampleRate, 0.01f));
+				 }});
+
+	s.push_back({"Sigma", "Sigma",
+				 [](Rig &r) {
+					 r.connect("Main", 16);
+					 r.connectOutputs();
+				 },
+				 [](Rig &r, int64_t frame, float sampleRate) {
+					 for (int c = 0; c < 16; ++c)
+						 r.input("Main").setVoltage(sine(frame, sampleRate, 1.f, c / 16.f), c);
+				 }});
+
+	s.push_back({"Fax", "Fax",
+				 [](Rig &r) {
+					 r.connect("CV");
+					 r.connect("Start Trigger");
+					 r.connect("Record Trigger");
+					 r.connectOutputs();
+				 },
+				 [](Rig &r, int64_t frame, float sampleRate) {
+					 r.input("CV").setVoltage(sine(frame, sampleRate, 0.5f));
+					 r.input("Start Trigger").setVoltage(once(frame, sampleRate, 0.01f));
+					 r.input("Record Trigger").setVoltage(once(frame, sampleRate, 0.01f));
+				 }});
+
+	s.push_back({"Rasoir", "Rasoir",
+				 [](Rig &r) {
+					 r.connect("Signal");
+					 r.param("Low Shift").setValue(0.2f);
+					 r.param("High Shift").setValue(0.3f);
+					 r.param("Low Pinch").setValue(0.4f);
+					 r.param("High Wavefold").setValue(0.5f);
+					 r.param("Low Slew Limiter").setValue(0.2f);
+					 r.connectOutputs();
+				 },
+				 [](Rig &r, int64_t frame, float sampleRate) {
+					 r.input("Signal").setVoltage(sine(frame, sampleRate, 110.f));
+				 }});
+
+	for (int channels : {1, 16})
+	{
+		s.push_back({string::f("Chi-%d", channels), "Chi",
+					 [channels](Rig &r) {
+						 r.connect("Main", channels);
+						 r.connectOutputs();
+					 },
+					 [channels](Rig &r, int64_t frame, float sampleRate) {
+						 Input &in = r.input("Main");
+						 for (int c = 0; c < channels; ++c)
+							 in.setVoltage(sine(frame, sampleRate, 55.f * (c + 1)), c);
+					 }});
+	}
+
+	// Every channel's crossovers swept by its own LFO, so the coefficients are worked out again every sample
+	s.push_back({"Chi-16-CV", "Chi",
+				 [](Rig &r) {
+					 r.connect("Main", 16);
+					 r.connect("Low/Mid Crossover Freq CV", 16);
+					 r.connect("Mid/High Crossover Freq CV", 16);
+					 r.connectOutputs();
+				 },
+				 [](Rig &r, int64_t frame, float sampleRate) {
+					 for (int c = 0; c < 16; ++c)
+					 {
+						 r.input("Main").setVoltage(sine(frame, sampleRate, 55.f * (c + 1)), c);
+						 r.input("Low/Mid Crossover Freq CV").setVoltage(sine(frame, sampleRate, 0.5f, c / 16.f), c);
+						 r.input("Mid/High Crossover Freq CV").setVoltage(sine(frame, sampleRate, 0.3f, c / 16.f), c);
+					 }
+				 }});
+
+	// Records eight slices over the first second, then plays them back with the pitch shifted
+	// Nova-0 plays back at the recorded pitch, the worst case for the clock edge that starts playback is the max column
+	for (float pitch : {0.25f, 0.f})
+	{
+		s.push_back({pitch == 0.f ? "Nova-0" : "Nova", "Nova",
+					 [pitch](Rig &r) {
+						 r.connect("Sampler");
+						 r.connect("Clock Trigger");
+						 r.connect("Start Trigger");
+						 r.connect("Record Arm Trigger");
+						 r.param("Global Sample Pitch").setValue(pitch);
+						 r.connectOutputs();
+					 },
+					 [](Rig &r, int64_t frame, float sampleRate) {
+						 r.input("Sampler").setVoltage(sine(frame, sampleRate, 220.f));
+						 r.input("Clock Trigger").setVoltage(pulse(frame, sampleRate, 8.f));
+						 r.input("Start Trigger").setVoltage(once(frame, sampleRate, 0.01f));
+						 r.input("Record Arm Trigger").setVoltage(once(frame, sampleRate, 0.01f) + once(frame, sampleRate, 1.01f));
+					 }});
+	}
+
+	s.push_back({"Lilt", "Lilt",
+				 [](Rig &r) { r.connectOutputs(); },
+				 [](Rig &r, int64_t frame, float sampleRate) {}});
+
+	s.push_back({"Botzinger", "Botzinger",
+				 [](Rig &r) { r.connectOutputs(); },
+				 [](Rig &r, int64_t frame, float sampleRate) {}});
+
+	s.push_back({"Shaney", "Shaney",
+				 [](Rig &r) {
+					 r.connect("External Clock Trigger");
+					 r.connectOutputs();
+				 },
+				 [](Rig &r, int64_t frame, float sampleRate) {
+					 r.input("External Clock Trigger").setVoltage(pulse(frame, sampleRate, 8.f));
+				 }});
+
+	return s;
+}
+
+typedef std::chrono::steady_clock Clock;
+
+static double nanoseconds(Clock::duration d)
+{
+	return std::chrono::duration<double, std::nano>(d).count();
+}
+
+struct Result
+{
+	double mean = 0.0;
+	double p99 = 0.0;
+	double max = 0.0;
+};
+
+struct Bench
+{
+	Plugin plugin;
+	double timerOverhead = 0.0;
+
+	Model *findModel(const std::string &slug)
+	{
+		for (Model *model : plugin.models)
+		{
+			if (model->slug == slug)
+				return model;
+		}
+		std::fprintf(stderr, "No model with slug \"%s\"\n", slug.c_str());
+		std::exit(1);
+	}
+
+	// Cost of reading the clock twice, subtracted from every per-sample timing
+	void calibrate()
+	{
+		std::vector<double> times(100000);
+		for (double &t : times)
+		{
+			Clock::time_point t0 = Clock::now();
+			Clock::time_point t1 = Clock::now();
+			t = nanoseconds(t1 - t0);
+		}
+		std::sort(times.begin(), times.end());
+		timerOverhead = times[times.size() / 2];
+	}
+
+	Module *create(const Scenario &scenario, Rig &rig, float sampleRate)
+	{
+		Module *module = findModel(scenario.slug)->createModule();
+		rig.module = module;
+		Module::SampleRateChangeEvent e;
+		e.sampleRate = sampleRate;
+		e.sampleTime = 1.f / sampleRate;
+		module->onSampleRateChange(e);
+		module->onAdd(Module::AddEvent());
+		scenario.setup(rig);
+		return module;
+	}
+
+	// Input voltages for every frame, rendered ahead of time so the timed loops only have to copy them
+	struct Script
+	{
+		std::vector<int> ports;
+		std::vector<int> channels;
+		std::vector<float> voltages;
+		size_t stride = 0;
+
+		void record(const Scenario &scenario, Rig &rig, float sampleRate, int64_t frames)
+		{
+			for (size_t i = 0; i < rig.module->inputs.size(); ++i)
+			{
+				if (rig.module->inputs[i].isConnected())
+				{
+					ports.push_back(i);
+					channels.push_back(rig.module->inputs[i].getChannels());
+					stride += rig.module->inputs[i].getChannels();
+				}
+			}
+
+			voltages.resize(stride * frames);
+			float *v = voltages.data();
+			for (int64_t frame = 0; frame < frames; ++frame)
+			{
+				scenario.drive(rig, frame, sampleRate);
+				for (size_t i = 0; i < ports.size(); ++i)
+				{
+					std::memcpy(v, rig.module->inputs[ports[i]].voltages, channels[i] * sizeof(float));
+					v += channels[i];
+				}
+			}
+		}
+
+		void play(Module *module, int64_t frame)
+		{
+			const float *v = &voltages[stride * frame];
+			for (size_t i = 0; i < ports.size(); ++i)
+			{
+				std::memcpy(module->inputs[ports[i]].voltages, v, channels[i] * sizeof(float));
+				v += channels[i];
+			}
+		}
+	};
+
+	Result run(const Scenario &scenario, float sampleRate, double seconds, int repeats)
+	{
+		Result result;
+		int64_t frames = std::max(1.0, seconds * sampleRate);
+		Module::ProcessArgs args;
+		args.sampleRate = sampleRate;
+		args.sampleTime = 1.f / sampleRate;
+
+		Script script;
+		{
+			Rig rig;
+			Module *module = create(scenario, rig, sampleRate);
+			script.record(scenario, rig, sampleRate, frames);
+			delete module;
+		}
+
+		// Throughput, timing whole runs minus the cost of replaying the inputs, best of several fresh instances
+		result.mean = INFINITY;
+		for (int repeat = 0; repeat < repeats; ++repeat)
+		{
+			Rig rig;
+			Module *module = create(scenario, rig, sampleRate);
+
+			Clock::time_point t0 = Clock::now();
+			for (int64_t frame = 0; frame < frames; ++frame)
+				script.play(module, frame);
+			Clock::time_point t1 = Clock::now();
+			for (int64_t frame = 0; frame < frames; ++frame)
+			{
+				script.play(module, frame);
+				args.frame = frame;
+				module->process(args);
+			}
+			Clock::time_point t2 = Clock::now();
+
+			result.mean = std::min(result.mean, std::max(0.0, nanoseconds((t2 - t1) - (t1 - t0)) / frames));
+			delete module;
+		}
+
+		// Latency distribution of individual process() calls
+		// Each frame keeps its best time over several fresh instances, so a one-off preemption by the OS doesn't show up as the worst case but a genuinely slow frame (eg a clock edge doing a lot of work) still does
+		{
+			std::vector<double> times(frames, INFINITY);
+
+			for (int repeat = 0; repeat < repeats; ++repeat)
+			{
+				Rig rig;
+				Module *module = create(scenario, rig, sampleRate);
+
+				for (int64_t frame = 0; frame < frames; ++frame)
+				{
+					script.play(module, frame);
+					args.frame = frame;
+					Clock::time_point t0 = Clock::now();
+					module->process(args);
+					Clock::time_point t1 = Clock::now();
+					times[frame] = std::min(times[frame], std::max(0.0, nanoseconds(t1 - t0) - timerOverhead));
+				}
+				delete module;
+			}
+
+			std::sort(times.begin(), times.end());
+			result.p99 = times[std::min(frames - 1, (int64_t)(frames * 0.99))];
+			result.max = times.back();
+		}
+
+		return result;
+	}
+};
+
+int main(int argc, char *argv[])
+{
+	double seconds = 2.0;
+	int repeats = 3;
+	std::vector<float> rates;
+	std::vector<std::string> names;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "-t" && i + 1 < argc)
+			seconds = std::atof(argv[++i]);
+		else if (arg == "-n" && i + 1 < argc)
+			repeats = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "-r" && i + 1 < argc)
+			rates.push_back(std::atof(argv[++i]));
+		else if (arg == "-h" || arg == "--help")
+		{
+			std::printf("Usage: %s [-t seconds] [-n repeats] [-r sampleRate]... [scenario]...\n", argv[0]);
+			return 0;
+		}
+		else
+			names.push_back(arg);
+	}
+	if (rates.empty())
+		rates = {44100.f, 48000.f, 96000.f, 192000.f};
+
+	random::init();
+	// Like Rack's engine threads, flush denormals to zero
+	_mm_setcsr(_mm_getcsr() | 0x8040);
+
+	Bench bench;
+	init(&bench.plugin);
+	bench.calibrate();
+
+	std::printf("%-12s %8s %12s %14s %10s %12s %8s\n", "scenario", "rate", "ns/sample", "samples/sec", "p99 ns", "max ns", "% core");
+	for (const Scenario &scenario : scenarios())
+	{
+		if (!names.empty() && std::find(names.begin(), names.end(), scenario.name) == names.end() && std::find(names.begin(), names.end(), scenario.slug) == names.end())
+			continue;
+
+		for (float rate : rates)
+		{
+			Result r = bench.run(scenario, rate, seconds, repeats);
+			double perSecond = r.mean > 0.0 ? 1e9 / r.mean : INFINITY;
+			double load = 100.0 * r.mean * rate / 1e9;
+			std::printf("%-12s %8.0f %12.1f %14.3g %10.1f %12.1f %8.3f\n", scenario.name.c_str(), rate, r.mean, perSecond, r.p99, r.max, load);
+			std::fflush(stdout);
+		}
+	}
+
+	// Modules remove their own patch storage directories, this is the parent the stub made them in
+	::rmdir(string::f("/tmp/rack-bench-%d", (int)::getpid()).c_str());
+
+	return 0;
+}
@@ -0,0 +1,1350 @@
+// Minimal stand-in for the parts of the VCV Rack 2 API used by the Fehler Fabrik modules
+// Only the engine side (Module, ports, params, lights and the dsp helpers) actually does anything
+// The widget side exists so that the *Widget structs in src/*.cpp compile, none of it is ever constructed
+// Anything that wraps an external library (speexdsp, libsamplerate) is a cheap linear stand-in,
+// so timings for code that leans on those are a lower bound
+#pragma once
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "simd.hpp"
+
+#define DEBUG(format, ...) std::fprintf(stderr, "[debug] " format "\n", ##__VA_ARGS__)
+#define INFO(format, ...) std::fprintf(stderr, "[info] " format "\n", ##__VA_ARGS__)
+#define WARN(format, ...) std::fprintf(stderr, "[warn] " format "\n", ##__VA_ARGS__)
+
+#define ENUMS(name, count) name, name##_LAST = name + (count)-1
+#define CHECKMARK_STRING "✔"
+#define CHECKMARK(cond) ((cond) ? CHECKMARK_STRING : "")
+#define RIGHT_ARROW "▸"
+
+////////////////////
+// JSON
+////////////////////
+
+// Just enough of jansson for dataToJson()/dataFromJson() to round trip
+struct json_t
+{
+	enum Type
+	{
+		OBJECT,
+		ARRAY,
+		STRING,
+		INTEGER,
+		REAL,
+		TRUE,
+		FALSE,
+		NUL
+	} type = NUL;
+	std::map<std::string, json_t *> object;
+	std::vector<json_t *> array;
+	std::string string;
+	long long integer = 0;
+	double real = 0.0;
+
+	~json_t()
+	{
+		for (auto &kv : object)
+			delete kv.second;
+		for (json_t *j : array)
+			delete j;
+	}
+};
+
+inline json_t *json_new(json_t::Type type)
+{
+	json_t *j = new json_t;
+	j->type = type;
+	return j;
+}
+inline json_t *json_object() { return json_new(json_t::OBJECT); }
+inline json_t *json_array() { return json_new(json_t::ARRAY); }
+inline json_t *json_boolean(bool b) { return json_new(b ? json_t::TRUE : json_t::FALSE); }
+inline json_t *json_integer(long long i)
+{
+	json_t *j = json_new(json_t::INTEGER);
+	j->integer = i;
+	return j;
+}
+inline json_t *json_real(double r)
+{
+	json_t *j = json_new(json_t::REAL);
+	j->real = r;
+	return j;
+}
+inline json_t *json_string(const char *s)
+{
+	json_t *j = json_new(json_t::STRING);
+	j->string = s;
+	return j;
+}
+inline void json_decref(json_t *j) { delete j; }
+inline int json_object_set_new(json_t *o, const char *key, json_t *value)
+{
+	json_t *&slot = o->object[key];
+	delete slot;
+	slot = value;
+	return 0;
+}
+inline json_t *json_object_get(const json_t *o, const char *key)
+{
+	if (!o || o->type != json_t::OBJECT)
+		return NULL;
+	auto it = o->object.find(key);
+	return it == o->object.end() ? NULL : it->second;
+}
+inline int json_array_append_new(json_t *a, json_t *value)
+{
+	a->array.push_back(value);
+	return 0;
+}
+inline int json_array_insert_new(json_t *a, size_t index, json_t *value)
+{
+	index = std::min(index, a->array.size());
+	a->array.insert(a->array.begin() + index, value);
+	return 0;
+}
+inline size_t json_array_size(const json_t *a) { return (a && a->type == json_t::ARRAY) ? a->array.size() : 0; }
+inline json_t *json_array_get(const json_t *a, size_t index) { return index < json_array_size(a) ? a->array[index] : NULL; }
+inline bool json_is_true(const json_t *j) { return j && j->type == json_t::TRUE; }
+inline bool json_boolean_value(const json_t *j) { return json_is_true(j); }
+inline long long json_integer_value(const json_t *j) { return (j && j->type == json_t::INTEGER) ? j->integer : 0; }
+inline double json_real_value(const json_t *j) { return (j && j->type == json_t::REAL) ? j->real : 0.0; }
+inline double json_number_value(const json_t *j)
+{
+	if (!j)
+		return 0.0;
+	return j->type == json_t::INTEGER ? (double)j->integer : json_real_value(j);
+}
+inline const char *json_string_value(const json_t *j) { return (j && j->type == json_t::STRING) ? j->string.c_str() : NULL; }
+
+namespace rack
+{
+
+////////////////////
+// math
+////////////////////
+
+namespace math
+{
+
+inline int clamp(int x, int a, int b) { return std::max(std::min(x, b), a); }
+inline float clamp(float x, float a = 0.f, float b = 1.f) { return std::fmax(std::fmin(x, b), a); }
+inline float sgn(float x) { return x > 0.f ? 1.f : (x < 0.f ? -1.f : 0.f); }
+inline float eucMod(float a, float b)
+{
+	float mod = std::fmod(a, b);
+	if (mod < 0.f)
+		mod += b;
+	return mod;
+}
+inline int eucMod(int a, int b)
+{
+	int mod = a % b;
+	if (mod < 0)
+		mod += b;
+	return mod;
+}
+template <typename T>
+T crossfade(T a, T b, T p) { return a + (b - a) * p; }
+inline float interpolateLinear(const float *p, float x)
+{
+	int xi = x;
+	float xf = x - xi;
+	return crossfade(p[xi], p[xi + 1], xf);
+}
+inline bool isPow2(int n) { return n > 0 && (n & (n - 1)) == 0; }
+
+struct Vec
+{
+	float x = 0.f;
+	float y = 0.f;
+	Vec() {}
+	Vec(float x, float y) : x(x), y(y) {}
+	Vec plus(Vec b) const { return Vec(x + b.x, y + b.y); }
+	Vec minus(Vec b) const { return Vec(x - b.x, y - b.y); }
+	Vec mult(float s) const { return Vec(x * s, y * s); }
+	Vec div(float s) const { return Vec(x / s, y / s); }
+};
+
+struct Rect
+{
+	Vec pos;
+	Vec size;
+};
+
+} // namespace math
+
+////////////////////
+// string, random, asset
+////////////////////
+
+namespace string
+{
+
+inline std::string f(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	char buf[1024];
+	std::vsnprintf(buf, sizeof(buf), format, args);
+	va_end(args);
+	return buf;
+}
+
+} // namespace string
+
+namespace random
+{
+
+// Same generator Rack uses, one per thread
+struct Xoroshiro128Plus
+{
+	uint64_t state[2] = {0x9E3779B97F4A7C15ull, 0xBF58476D1CE4E5B9ull};
+
+	static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+	uint64_t operator()()
+	{
+		uint64_t s0 = state[0];
+		uint64_t s1 = state[1];
+		uint64_t result = s0 + s1;
+		s1 ^= s0;
+		state[0] = rotl(s0, 55) ^ s1 ^ (s1 << 14);
+		state[1] = rotl(s1, 36);
+		return result;
+	}
+};
+
+inline Xoroshiro128Plus &local()
+{
+	static thread_local Xoroshiro128Plus rng;
+	return rng;
+}
+inline void init() {}
+inline uint64_t u64() { return local()(); }
+inline uint32_t u32() { return u64() >> 32; }
+inline float uniform() { return (u32() >> 8) * (1.f / 16777216.f); }
+inline float normal()
+{
+	// Box-Muller, as in Rack
+	const float radius = std::sqrt(-2.f * std::log(1.f - uniform()));
+	const float theta = 2.f * M_PI * uniform();
+	return radius * std::sin(theta);
+}
+
+} // namespace random
+
+namespace plugin
+{
+struct Plugin;
+struct Model;
+} // namespace plugin
+
+namespace system
+{
+inline std::string join(const std::string &path1, const std::string &path2)
+{
+	return path1 + "/" + path2;
+}
+
+inline bool exists(const std::string &path)
+{
+	struct stat st;
+	return ::stat(path.c_str(), &st) == 0;
+}
+
+inline bool remove(const std::string &path)
+{
+	return std::remove(path.c_str()) == 0;
+}
+
+inline bool createDirectories(const std::string &path)
+{
+	for (size_t i = 1; i <= path.size(); ++i)
+	{
+		if (i == path.size() || path[i] == '/')
+			::mkdir(path.substr(0, i).c_str(), 0755);
+	}
+	return exists(path);
+}
+
+// Removes a directory and the files directly inside it
+inline void removeRecursively(const std::string &path)
+{
+	if (DIR *dir = ::opendir(path.c_str()))
+	{
+		while (struct dirent *entry = ::readdir(dir))
+		{
+			std::string name = entry->d_name;
+			if (name != "." && name != "..")
+				remove(join(path, name));
+		}
+		::closedir(dir);
+	}
+	::rmdir(path.c_str());
+}
+} // namespace system
+
+namespace asset
+{
+
+inline std::string plugin(plugin::Plugin *plugin, std::string filename) { return filename; }
+inline std::string user(std::string filename) { return filename; }
+
+} // namespace asset
+
+////////////////////
+// dsp
+////////////////////
+
+namespace dsp
+{
+
+static const float FREQ_C4 = 261.6256f;
+static const float FREQ_A4 = 440.0000f;
+static const float FREQ_SEMITONE = 1.0594630943592953f;
+
+// 2^floor(x) from the exponent bits, xf gets the rest
+template <typename T>
+T approxExp2Floor(T x, T *xf);
+
+template <>
+inline simd::float_4 approxExp2Floor(simd::float_4 x, simd::float_4 *xf)
+{
+	simd::int32_4 xi = x;
+	if (xf)
+		*xf = x - simd::float_4(xi);
+	simd::int32_4 y = (xi + 127) << 23;
+	return simd::float_4::cast(y);
+}
+
+template <>
+inline float approxExp2Floor(float x, float *xf)
+{
+	int32_t xi = x;
+	if (xf)
+		*xf = x - xi;
+	union
+	{
+		int32_t i;
+		float f;
+	} y;
+	y.i = (xi + 127) << 23;
+	return y.f;
+}
+
+template <typename T>
+T approxExp2_taylor5(T x)
+{
+	T xf;
+	T yi = approxExp2Floor(x, &xf);
+
+	const T a[] = {
+		1.0,
+		0.69315169353961,
+		0.2401595528554,
+		0.055817399666768,
+		0.0089355131253021,
+		0.0018778921972879,
+	};
+	T yf = a[5];
+	yf = yf * xf + a[4];
+	yf = yf * xf + a[3];
+	yf = yf * xf + a[2];
+	yf = yf * xf + a[1];
+	yf = yf * xf + a[0];
+	return yi * yf;
+}
+
+template <int CHANNELS, typename T = float>
+struct Frame
+{
+	T samples[CHANNELS];
+};
+
+template <typename T = float>
+struct TSchmittTrigger
+{
+	bool state = true;
+
+	void reset() { state = true; }
+
+	bool process(T in, T lowThreshold = 0.f, T highThreshold = 1.f)
+	{
+		if (state)
+		{
+			if (in <= lowThreshold)
+				state = false;
+		}
+		else
+		{
+			if (in >= highThreshold)
+			{
+				state = true;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool isHigh() { return state; }
+};
+
+// Rack's SIMD version, returns a mask of the lanes that triggered
+template <>
+struct TSchmittTrigger<simd::float_4>
+{
+	simd::float_4 state = simd::float_4::mask();
+
+	void reset() { state = simd::float_4::mask(); }
+
+	simd::float_4 process(simd::float_4 in, simd::float_4 lowThreshold = 0.f, simd::float_4 highThreshold = 1.f)
+	{
+		simd::float_4 on = (in >= highThreshold);
+		simd::float_4 off = (in <= lowThreshold);
+		simd::float_4 triggered = ~state & on;
+		state = on | (state & ~off);
+		return triggered;
+	}
+};
+
+typedef TSchmittTrigger<> SchmittTrigger;
+
+struct PulseGenerator
+{
+	float remaining = 0.f;
+
+	void reset() { remaining = 0.f; }
+
+	bool process(float deltaTime)
+	{
+		if (remaining > 0.f)
+		{
+			remaining -= deltaTime;
+			return true;
+		}
+		return false;
+	}
+
+	void trigger(float duration = 1e-3f)
+	{
+		if (duration > remaining)
+			remaining = duration;
+	}
+};
+
+template <typename T = float>
+struct TTimer
+{
+	T time = 0.f;
+
+	void reset() { time = 0.f; }
+
+	T process(T deltaTime)
+	{
+		time += deltaTime;
+		return time;
+	}
+};
+typedef TTimer<> Timer;
+
+struct ClockDivider
+{
+	uint32_t clock = 0;
+	uint32_t division = 1;
+
+	void reset() { clock = 0; }
+	void setDivision(uint32_t division) { this->division = division; }
+	uint32_t getDivision() { return division; }
+	uint32_t getClock() { return clock; }
+
+	bool process()
+	{
+		clock++;
+		if (clock >= division)
+		{
+			clock = 0;
+			return true;
+		}
+		return false;
+	}
+};
+
+template <typename T, size_t S>
+struct RingBuffer
+{
+	std::atomic<size_t> start{0};
+	std::atomic<size_t> end{0};
+	T data[S];
+
+	size_t mask(size_t i) const { return i & (S - 1); }
+	void push(T t) { data[mask(end++)] = t; }
+	T shift() { return data[mask(start++)]; }
+	void clear() { start = end.load(); }
+	bool empty() const { return start >= end; }
+	bool full() const { return end - start >= S; }
+	size_t size() const { return end - start; }
+	size_t capacity() const { return S - size(); }
+};
+
+template <typename T, size_t S>
+struct DoubleRingBuffer
+{
+	std::atomic<size_t> start{0};
+	std::atomic<size_t> end{0};
+	T data[2 * S];
+
+	size_t mask(size_t i) const { return i & (S - 1); }
+	void push(T t)
+	{
+		size_t i = mask(end++);
+		data[i] = t;
+		data[i + S] = t;
+	}
+	T shift() { return data[mask(start++)]; }
+	void clear() { start = end.load(); }
+	bool empty() const { return start >= end; }
+	bool full() const { return end - start >= S; }
+	size_t size() const { return end - start; }
+	size_t capacity() const { return S - size(); }
+	T *endData() { return &data[mask(end)]; }
+	void endIncr(size_t n)
+	{
+		size_t e = mask(end);
+		size_t e1 = e + n;
+		size_t e2 = std::min(e1, S);
+		std::memcpy(&data[S + e], &data[e], sizeof(T) * (e2 - e));
+		if (e1 > S)
+			std::memcpy(data, &data[S], sizeof(T) * (e1 - S));
+		end += n;
+	}
+	const T *startData() const { return &data[mask(start)]; }
+	void startIncr(size_t n) { start += n; }
+};
+
+template <int B_ORDER, int A_ORDER, typename T = float>
+struct IIRFilter
+{
+	T b[B_ORDER] = {};
+	T a[A_ORDER - 1] = {};
+	T x[B_ORDER - 1];
+	T y[A_ORDER - 1];
+
+	IIRFilter() { reset(); }
+
+	void reset()
+	{
+		for (int i = 1; i < B_ORDER; i++)
+			x[i - 1] = 0.f;
+		for (int i = 1; i < A_ORDER; i++)
+			y[i - 1] = 0.f;
+	}
+
+	void setCoefficients(const T *b, const T *a)
+	{
+		for (int i = 0; i < B_ORDER; i++)
+			this->b[i] = b[i];
+		for (int i = 1; i < A_ORDER; i++)
+			this->a[i - 1] = a[i - 1];
+	}
+
+	T process(T in)
+	{
+		T out = 0.f;
+		if (0 < B_ORDER)
+			out = b[0] * in;
+		for (int i = 1; i < B_ORDER; i++)
+			out += b[i] * x[i - 1];
+		for (int i = 1; i < A_ORDER; i++)
+			out -= a[i - 1] * y[i - 1];
+		for (int i = B_ORDER - 1; i >= 2; i--)
+			x[i - 1] = x[i - 2];
+		x[0] = in;
+		for (int i = A_ORDER - 1; i >= 2; i--)
+			y[i - 1] = y[i - 2];
+		y[0] = out;
+		return out;
+	}
+};
+
+// Plain radix-2 FFT in place of pffft, with the same interface and "canonical" ordering as Rack's RealFFT
+// irfft(rfft(x)) = length * x, scale() divides that back out
+struct RealFFT
+{
+	int length;
+
+	RealFFT(size_t length) : length(length) {}
+
+	static void transform(std::vector<double> &re, std::vector<double> &im, bool inverse)
+	{
+		int n = re.size();
+		for (int i = 1, j = 0; i < n; ++i)
+		{
+			int bit = n >> 1;
+			for (; j & bit; bit >>= 1)
+				j ^= bit;
+			j ^= bit;
+			if (i < j)
+			{
+				std::swap(re[i], re[j]);
+				std::swap(im[i], im[j]);
+			}
+		}
+		for (int size = 2; size <= n; size <<= 1)
+		{
+			double angle = (inverse ? 2.0 : -2.0) * M_PI / size;
+			// Each twiddle factor is worked out once per stage
+			for (int k = 0; k < size / 2; ++k)
+			{
+				double wr = std::cos(angle * k);
+				double wi = std::sin(angle * k);
+				for (int start = 0; start < n; start += size)
+				{
+					int a = start + k;
+					int b = a + size / 2;
+					double tr = re[b] * wr - im[b] * wi;
+					double ti = re[b] * wi + im[b] * wr;
+					re[b] = re[a] - tr;
+					im[b] = im[a] - ti;
+					re[a] += tr;
+					im[a] += ti;
+				}
+			}
+		}
+	}
+
+	// output[0] = F(0), output[1] = F(n/2), output[2k], output[2k + 1] = real, imag F(k)
+	void rfft(const float *input, float *output)
+	{
+		std::vector<double> re(input, input + length);
+		std::vector<double> im(length, 0.0);
+		transform(re, im, false);
+		output[0] = re[0];
+		output[1] = re[length / 2];
+		for (int k = 1; k < length / 2; ++k)
+		{
+			output[2 * k] = re[k];
+			output[2 * k + 1] = im[k];
+		}
+	}
+
+	void irfft(const float *input, float *output)
+	{
+		std::vector<double> re(length);
+		std::vector<double> im(length);
+		re[0] = input[0];
+		im[0] = 0.0;
+		re[length / 2] = input[1];
+		im[length / 2] = 0.0;
+		for (int k = 1; k < length / 2; ++k)
+		{
+			re[k] = input[2 * k];
+			im[k] = input[2 * k + 1];
+			re[length - k] = input[2 * k];
+			im[length - k] = -input[2 * k + 1];
+		}
+		transform(re, im, true);
+		for (int i = 0; i < length; ++i)
+			output[i] = re[i];
+	}
+
+	void scale(float *x)
+	{
+		for (int i = 0; i < length; ++i)
+			x[i] /= length;
+	}
+};
+
+// Linear interpolation in place of speexdsp
+template <int CHANNELS>
+struct SampleRateConverter
+{
+	double inRate = 44100.0;
+	double outRate = 44100.0;
+
+	void setQuality(int quality) {}
+	void setRates(int inRate, int outRate)
+	{
+		this->inRate = inRate;
+		this->outRate = outRate;
+	}
+	void refreshState() {}
+
+	void process(const Frame<CHANNELS> *in, int *inFrames, Frame<CHANNELS> *out, int *outFrames)
+	{
+		double step = inRate / outRate;
+		int outLen = std::min(*outFrames, (int)(*inFrames / step));
+		int used = 0;
+		for (int i = 0; i < outLen; i++)
+		{
+			double pos = i * step;
+			int pi = (int)pos;
+			float f = pos - pi;
+			int pj = std::min(pi + 1, *inFrames - 1);
+			for (int c = 0; c < CHANNELS; c++)
+				out[i].samples[c] = in[pi].samples[c] + (in[pj].samples[c] - in[pi].samples[c]) * f;
+			used = pj + 1;
+		}
+		*inFrames = used;
+		*outFrames = outLen;
+	}
+};
+
+} // namespace dsp
+
+////////////////////
+// engine
+////////////////////
+
+namespace engine
+{
+
+static const int PORT_MAX_CHANNELS = 16;
+
+struct Param
+{
+	float value = 0.f;
+	float getValue() { return value; }
+	void setValue(float value) { this->value = value; }
+};
+
+struct Port
+{
+	float voltages[PORT_MAX_CHANNELS] = {};
+	int channels = 0;
+
+	void setVoltage(float voltage, int channel = 0) { voltages[channel] = voltage; }
+	float getVoltage(int channel = 0) { return voltages[channel]; }
+	float getPolyVoltage(int channel) { return isMonophonic() ? getVoltage(0) : getVoltage(channel); }
+	float getNormalVoltage(float normalVoltage, int channel = 0) { return isConnected() ? getVoltage(channel) : normalVoltage; }
+	float getNormalPolyVoltage(float normalVoltage, int channel) { return isConnected() ? getPolyVoltage(channel) : normalVoltage; }
+	float *getVoltages(int firstChannel = 0) { return &voltages[firstChannel]; }
+	template <typename T>
+	T getVoltageSimd(int firstChannel) { return T::load(&voltages[firstChannel]); }
+	template <typename T>
+	T getPolyVoltageSimd(int firstChannel) { return isMonophonic() ? T(getVoltage(0)) : getVoltageSimd<T>(firstChannel); }
+	template <typename T>
+	void setVoltageSimd(T voltage, int firstChannel) { voltage.store(&voltages[firstChannel]); }
+	void readVoltages(float *v)
+	{
+		for (int c = 0; c < channels; c++)
+			v[c] = voltages[c];
+	}
+	void writeVoltages(const float *v)
+	{
+		for (int c = 0; c < channels; c++)
+			voltages[c] = v[c];
+	}
+	void clearVoltages()
+	{
+		for (int c = 0; c < channels; c++)
+			voltages[c] = 0.f;
+	}
+
+	void setChannels(int channels)
+	{
+		// If disconnected, keep the number of channels at 0
+		if (this->channels == 0)
+			return;
+		for (int c = channels; c < this->channels; c++)
+			voltages[c] = 0.f;
+		if (channels == 0)
+			channels = 1;
+		this->channels = channels;
+	}
+
+	int getChannels() { return channels; }
+	bool isConnected() { return channels > 0; }
+	bool isMonophonic() { return channels == 1; }
+	bool isPolyphonic() { return channels > 1; }
+};
+
+struct Input : Port
+{
+};
+
+struct Output : Port
+{
+};
+
+struct Light
+{
+	float value = 0.f;
+
+	void setBrightness(float brightness) { value = brightness; }
+	float getBrightness() { return value; }
+	void setBrightnessSmooth(float brightness, float deltaTime, float lambda = 30.f)
+	{
+		if (brightness < value)
+			value += (brightness - value) * lambda * deltaTime;
+		else
+			value = brightness;
+	}
+	void setSmoothBrightness(float brightness, float deltaTime) { setBrightnessSmooth(brightness, deltaTime); }
+};
+
+struct Module;
+
+struct ParamQuantity
+{
+	Module *module = NULL;
+	int paramId = -1;
+	float minValue = 0.f;
+	float maxValue = 1.f;
+	float defaultValue = 0.f;
+	std::string name;
+	std::string unit;
+	bool snapEnabled = false;
+	bool randomizeEnabled = true;
+
+	virtual ~ParamQuantity() {}
+	float getValue();
+	void setValue(float value);
+	virtual float getDisplayValue() { return getValue(); }
+	virtual void setDisplayValue(float displayValue) { setValue(displayValue); }
+};
+
+struct SwitchQuantity : ParamQuantity
+{
+	std::vector<std::string> labels;
+};
+
+struct PortInfo
+{
+	std::string name;
+	std::string description;
+};
+
+struct LightInfo
+{
+	std::string name;
+	std::string description;
+};
+
+struct Module
+{
+	plugin::Model *model = NULL;
+	int64_t id = -1;
+
+	std::vector<Param> params;
+	std::vector<Input> inputs;
+	std::vector<Output> outputs;
+	std::vector<Light> lights;
+
+	std::vector<ParamQuantity *> paramQuantities;
+	std::vector<PortInfo *> inputInfos;
+	std::vector<PortInfo *> outputInfos;
+	std::vector<LightInfo *> lightInfos;
+
+	// Each instance gets its own scratch directory, only created if a module asks for it
+	std::string patchStorageDirectory;
+
+	Module()
+	{
+		static std::atomic<int> count{0};
+		patchStorageDirectory = string::f("/tmp/rack-bench-%d/%d", (int)::getpid(), count++);
+	}
+
+	virtual ~Module()
+	{
+		system::removeRecursively(patchStorageDirectory);
+		for (ParamQuantity *pq : paramQuantities)
+			delete pq;
+		for (PortInfo *pi : inputInfos)
+			delete pi;
+		for (PortInfo *pi : outputInfos)
+			delete pi;
+		for (LightInfo *li : lightInfos)
+			delete li;
+	}
+
+	void config(int numParams, int numInputs, int numOutputs, int numLights = 0)
+	{
+		params.resize(numParams);
+		inputs.resize(numInputs);
+		outputs.resize(numOutputs);
+		lights.resize(numLights);
+		paramQuantities.resize(numParams);
+		inputInfos.resize(numInputs);
+		outputInfos.resize(numOutputs);
+		lightInfos.resize(numLights);
+	}
+
+	template <class TParamQuantity = ParamQuantity>
+	TParamQuantity *configParam(int paramId, float minValue, float maxValue, float defaultValue, std::string name = "", std::string unit = "", float displayBase = 0.f, float displayMultiplier = 1.f, float displayOffset = 0.f)
+	{
+		delete paramQuantities[paramId];
+		TParamQuantity *q = new TParamQuantity;
+		q->module = this;
+		q->paramId = paramId;
+		q->minValue = minValue;
+		q->maxValue = maxValue;
+		q->defaultValue = defaultValue;
+		q->name = name;
+		q->unit = unit;
+		paramQuantities[paramId] = q;
+		params[paramId].value = defaultValue;
+		return q;
+	}
+
+	template <class TSwitchQuantity = SwitchQuantity>
+	TSwitchQuantity *configSwitch(int paramId, float minValue, float maxValue, float defaultValue, std::string name = "", std::vector<std::string> labels = {})
+	{
+		TSwitchQuantity *sq = configParam<TSwitchQuantity>(paramId, minValue, maxValue, defaultValue, name);
+		sq->snapEnabled = true;
+		sq->labels = labels;
+		return sq;
+	}
+
+	template <class TSwitchQuantity = SwitchQuantity>
+	TSwitchQuantity *configButton(int paramId, std::string name = "")
+	{
+		TSwitchQuantity *sq = configParam<TSwitchQuantity>(paramId, 0.f, 1.f, 0.f, name);
+		sq->randomizeEnabled = false;
+		return sq;
+	}
+
+	PortInfo *configInput(int portId, std::string name = "")
+	{
+		delete inputInfos[portId];
+		inputInfos[portId] = new PortInfo;
+		inputInfos[portId]->name = name;
+		return inputInfos[portId];
+	}
+
+	PortInfo *configOutput(int portId, std::string name = "")
+	{
+		delete outputInfos[portId];
+		outputInfos[portId] = new PortInfo;
+		outputInfos[portId]->name = name;
+		return outputInfos[portId];
+	}
+
+	LightInfo *configLight(int lightId, std::string name = "")
+	{
+		delete lightInfos[lightId];
+		lightInfos[lightId] = new LightInfo;
+		lightInfos[lightId]->name = name;
+		return lightInfos[lightId];
+	}
+
+	void configBypass(int inputId, int outputId) {}
+
+	std::string getPatchStorageDirectory() { return patchStorageDirectory; }
+	std::string createPatchStorageDirectory()
+	{
+		system::createDirectories(patchStorageDirectory);
+		return patchStorageDirectory;
+	}
+
+	struct ProcessArgs
+	{
+		float sampleRate;
+		float sampleTime;
+		int64_t frame;
+	};
+	virtual void process(const ProcessArgs &args) {}
+
+	struct SampleRateChangeEvent
+	{
+		float sampleRate;
+		float sampleTime;
+	};
+	virtual void onSampleRateChange(const SampleRateChangeEvent &e) { onSampleRateChange(); }
+	virtual void onSampleRateChange() {}
+
+	struct AddEvent
+	{
+	};
+	virtual void onAdd(const AddEvent &e) { onAdd(); }
+	virtual void onAdd() {}
+
+	struct RemoveEvent
+	{
+	};
+	virtual void onRemove(const RemoveEvent &e) { onRemove(); }
+	virtual void onRemove() {}
+
+	struct SaveEvent
+	{
+	};
+	virtual void onSave(const SaveEvent &e) {}
+
+	struct ResetEvent
+	{
+	};
+	virtual void onReset(const ResetEvent &e) { onReset(); }
+	virtual void onReset() {}
+
+	virtual json_t *dataToJson() { return NULL; }
+	virtual void dataFromJson(json_t *rootJ) {}
+};
+
+inline float ParamQuantity::getValue()
+{
+	return module->params[paramId].getValue();
+}
+
+inline void ParamQuantity::setValue(float value)
+{
+	module->params[paramId].setValue(math::clamp(value, minValue, maxValue));
+}
+
+struct Engine
+{
+	float sampleRate = 48000.f;
+	float getSampleRate() { return sampleRate; }
+};
+
+} // namespace engine
+
+////////////////////
+// plugin
+////////////////////
+
+namespace plugin
+{
+
+struct Model
+{
+	Plugin *plugin = NULL;
+	std::string slug;
+	virtual ~Model() {}
+	virtual engine::Module *createModule() = 0;
+};
+
+struct Plugin
+{
+	std::vector<Model *> models;
+
+	void addModel(Model *model)
+	{
+		model->plugin = this;
+		models.push_back(model);
+	}
+};
+
+} // namespace plugin
+
+////////////////////
+// widgets (compile only)
+////////////////////
+
+namespace window
+{
+
+struct Svg
+{
+};
+
+inline math::Vec mm2px(math::Vec mm) { return mm.mult(75.f / 25.4f); }
+
+struct Window
+{
+	std::shared_ptr<Svg> loadSvg(const std::string &filename) { return std::make_shared<Svg>(); }
+};
+
+} // namespace window
+
+struct Context
+{
+	window::Window *window = NULL;
+	engine::Engine *engine = NULL;
+};
+inline Context *contextGet()
+{
+	static Context context;
+	return &context;
+}
+#define APP rack::contextGet()
+
+namespace event
+{
+struct Action
+{
+};
+} // namespace event
+
+namespace widget
+{
+
+struct Widget
+{
+	math::Rect box;
+	std::list<Widget *> children;
+
+	virtual ~Widget()
+	{
+		for (Widget *child : children)
+			delete child;
+	}
+	void addChild(Widget *child) { children.push_back(child); }
+	virtual void step() {}
+};
+
+} // namespace widget
+
+namespace ui
+{
+
+struct Menu : widget::Widget
+{
+};
+
+struct MenuEntry : widget::Widget
+{
+};
+
+struct MenuLabel : MenuEntry
+{
+	std::string text;
+};
+
+struct MenuSeparator : MenuEntry
+{
+};
+
+struct MenuItem : MenuEntry
+{
+	std::string text;
+	std::string rightText;
+	bool disabled = false;
+	virtual void onAction(const event::Action &e) {}
+	virtual Menu *createChildMenu() { return NULL; }
+};
+
+} // namespace ui
+
+namespace app
+{
+
+static const float RACK_GRID_WIDTH = 15;
+static const float RACK_GRID_HEIGHT = 380;
+
+struct SvgWidget : widget::Widget
+{
+	void setSvg(std::shared_ptr<window::Svg> svg) {}
+};
+
+struct SvgPanel : widget::Widget
+{
+	void setBackground(std::shared_ptr<window::Svg> svg) {}
+};
+
+struct ParamWidget : widget::Widget
+{
+	engine::Module *module = NULL;
+	int paramId = -1;
+};
+
+struct SvgKnob : ParamWidget
+{
+	void setSvg(std::shared_ptr<window::Svg> svg) {}
+};
+
+struct RoundKnob : SvgKnob
+{
+	bool snap = false;
+};
+
+struct SvgSwitch : ParamWidget
+{
+	bool momentary = false;
+	void addFrame(std::shared_ptr<window::Svg> svg) {}
+};
+
+struct SvgSlider : ParamWidget
+{
+};
+
+struct PortWidget : widget::Widget
+{
+	engine::Module *module = NULL;
+	int portId = -1;
+};
+
+struct SvgPort : PortWidget
+{
+	void setSvg(std::shared_ptr<window::Svg> svg) {}
+};
+
+struct SvgScrew : widget::Widget
+{
+	void setSvg(std::shared_ptr<window::Svg> svg) {}
+};
+
+struct ModuleLightWidget : widget::Widget
+{
+	engine::Module *module = NULL;
+	int firstLightId = -1;
+};
+
+struct ModuleWidget : widget::Widget
+{
+	engine::Module *module = NULL;
+
+	void setModule(engine::Module *module) { this->module = module; }
+	void setPanel(widget::Widget *panel) { addChild(panel); }
+	void setPanel(std::shared_ptr<window::Svg> svg) {}
+	void addParam(ParamWidget *param) { addChild(param); }
+	void addInput(PortWidget *input) { addChild(input); }
+	void addOutput(PortWidget *output) { addChild(output); }
+	virtual void appendContextMenu(ui::Menu *menu) {}
+};
+
+} // namespace app
+
+namespace componentlibrary
+{
+
+struct RedLight : app::ModuleLightWidget
+{
+};
+struct GreenLight : app::ModuleLightWidget
+{
+};
+struct RedGreenBlueLight : app::ModuleLightWidget
+{
+};
+template <typename TBase>
+struct MediumLight : TBase
+{
+};
+template <typename TBase>
+struct SmallLight : TBase
+{
+};
+struct CKSS : app::SvgSwitch
+{
+};
+struct CKSSThree : app::SvgSwitch
+{
+};
+struct BefacoSlidePot : app::SvgSlider
+{
+};
+template <typename TLightBase = RedLight>
+struct LEDLightSlider : app::SvgSlider
+{
+};
+
+} // namespace componentlibrary
+
+using namespace math;
+using namespace window;
+using namespace widget;
+using namespace ui;
+using namespace app;
+using namespace engine;
+using namespace componentlibrary;
+using plugin::Model;
+using plugin::Plugin;
+
+template <class TWidget>
+TWidget *createWidget(math::Vec pos)
+{
+	TWidget *w = new TWidget;
+	w->box.pos = pos;
+	return w;
+}
+
+template <class TWidget>
+TWidget *createWidgetCentered(math::Vec pos)
+{
+	return createWidget<TWidget>(pos);
+}
+
+inline app::SvgPanel *createPanel(std::string svgPath) { return new app::SvgPanel; }
+
+template <class TParamWidget>
+TParamWidget *createParamCentered(math::Vec pos, engine::Module *module, int paramId)
+{
+	TParamWidget *o = createWidget<TParamWidget>(pos);
+	o->module = module;
+	o->paramId = paramId;
+	return o;
+}
+
+template <class TParamWidget>
+TParamWidget *createLightParamCentered(math::Vec pos, engine::Module *module, int paramId, int firstLightId)
+{
+	return createParamCentered<TParamWidget>(pos, module, paramId);
+}
+
+template <class TPortWidget>
+TPortWidget *createInputCentered(math::Vec pos, engine::Module *module, int inputId)
+{
+	TPortWidget *o = createWidget<TPortWidget>(pos);
+	o->module = module;
+	o->portId = inputId;
+	return o;
+}
+
+template <class TPortWidget>
+TPortWidget *createOutputCentered(math::Vec pos, engine::Module *module, int outputId)
+{
+	return createInputCentered<TPortWidget>(pos, module, outputId);
+}
+
+template <class TModuleLightWidget>
+TModuleLightWidget *createLightCentered(math::Vec pos, engine::Module *module, int firstLightId)
+{
+	TModuleLightWidget *o = createWidget<TModuleLightWidget>(pos);
+	o->module = module;
+	o->firstLightId = firstLightId;
+	return o;
+}
+
+template <class TMenuItem = ui::MenuItem>
+TMenuItem *createMenuItem(std::string text, std::string rightText = "")
+{
+	TMenuItem *o = new TMenuItem;
+	o->text = text;
+	o->rightText = rightText;
+	return o;
+}
+
+template <class TModule, class TModuleWidget>
+plugin::Model *createModel(std::string slug)
+{
+	struct TModel : plugin::Model
+	{
+		engine::Module *createModule() override
+		{
+			TModule *m = new TModule;
+			m->model = this;
+			return m;
+		}
+	};
+
+	TModel *o = new TModel;
+	o->slug = slug;
+	return o;
+}
+
+} // namespace rack
+
+// Defined by the plugin in plugin.cpp
+extern "C" void init(rack::plugin::Plugin *plugin);
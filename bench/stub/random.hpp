@@ -0,0 +1,3 @@
+// rack::random lives in rack.hpp in this stub
+#pragma once
+#include "rack.hpp"
@@ -0,0 +1,78 @@
+// Minimal stand-in for libsamplerate
+// Streaming linear interpolation, so it's much cheaper than the sinc converters it replaces
+#pragma once
+
+enum
+{
+	SRC_SINC_BEST_QUALITY = 0,
+	SRC_SINC_MEDIUM_QUALITY = 1,
+	SRC_SINC_FASTEST = 2,
+	SRC_ZERO_ORDER_HOLD = 3,
+	SRC_LINEAR = 4
+};
+
+typedef struct
+{
+	const float *data_in;
+	float *data_out;
+	long input_frames, output_frames;
+	long input_frames_used, output_frames_gen;
+	int end_of_input;
+	double src_ratio;
+} SRC_DATA;
+
+typedef struct
+{
+	// Last consumed input sample and the read position between it and the next one
+	float previous;
+	double position;
+} SRC_STATE;
+
+inline SRC_STATE *src_new(int converter_type, int channels, int *error)
+{
+	if (error)
+		*error = 0;
+	SRC_STATE *state = new SRC_STATE;
+	state->previous = 0.f;
+	state->position = 0.0;
+	return state;
+}
+
+inline SRC_STATE *src_delete(SRC_STATE *state)
+{
+	delete state;
+	return nullptr;
+}
+
+inline int src_reset(SRC_STATE *state)
+{
+	state->previous = 0.f;
+	state->position = 0.0;
+	return 0;
+}
+
+inline int src_process(SRC_STATE *state, SRC_DATA *data)
+{
+	long in = 0;
+	long out = 0;
+	double step = 1.0 / data->src_ratio;
+
+	while (out < data->output_frames)
+	{
+		while (state->position >= 1.0 && in < data->input_frames)
+		{
+			state->previous = data->data_in[in++];
+			state->position -= 1.0;
+		}
+		if (state->position >= 1.0 || in >= data->input_frames)
+			break;
+
+		float next = data->data_in[in];
+		data->data_out[out++] = state->previous + (next - state->previous) * (float)state->position;
+		state->position += step;
+	}
+
+	data->input_frames_used = in;
+	data->output_frames_gen = out;
+	return 0;
+}
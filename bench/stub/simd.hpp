@@ -0,0 +1,274 @@
+// Stand-in for Rack's simd::float_4 and the vector math functions in simd/functions.hpp
+// Same SSE layout and the same sse_mathfun (Cephes) polynomials Rack uses, so vector code costs what it would in Rack
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <immintrin.h>
+
+namespace rack
+{
+namespace simd
+{
+
+struct int32_4;
+
+// Lanes are read through a union as Rack does, casting &v to float * breaks strict aliasing
+struct float_4
+{
+	union
+	{
+		__m128 v;
+		float s[4];
+	};
+
+	float_4() = default;
+	float_4(__m128 v) : v(v) {}
+	float_4(float x) { v = _mm_set1_ps(x); }
+	float_4(float x1, float x2, float x3, float x4) { v = _mm_setr_ps(x1, x2, x3, x4); }
+
+	static float_4 zero() { return float_4(_mm_setzero_ps()); }
+	static float_4 mask() { return float_4(_mm_castsi128_ps(_mm_set1_epi32(-1))); }
+	static float_4 load(const float *x) { return float_4(_mm_loadu_ps(x)); }
+	void store(float *x) { _mm_storeu_ps(x, v); }
+
+	// Reinterprets the bits, the constructor converts the values
+	static float_4 cast(int32_4 a);
+	float_4(int32_4 a);
+
+	float &operator[](int i) { return s[i]; }
+	const float &operator[](int i) const { return s[i]; }
+};
+
+struct int32_4
+{
+	union
+	{
+		__m128i v;
+		int32_t s[4];
+	};
+
+	int32_4() = default;
+	int32_4(__m128i v) : v(v) {}
+	int32_4(int32_t x) { v = _mm_set1_epi32(x); }
+	int32_4(int32_t x1, int32_t x2, int32_t x3, int32_t x4) { v = _mm_setr_epi32(x1, x2, x3, x4); }
+
+	static int32_4 zero() { return int32_4(_mm_setzero_si128()); }
+	static int32_4 load(const int32_t *x) { return int32_4(_mm_loadu_si128((const __m128i *)x)); }
+	void store(int32_t *x) { _mm_storeu_si128((__m128i *)x, v); }
+
+	int32_t &operator[](int i) { return s[i]; }
+	const int32_t &operator[](int i) const { return s[i]; }
+
+	// Reinterprets the bits, the constructor converts (truncating) the values
+	static int32_4 cast(float_4 a) { return int32_4(_mm_castps_si128(a.v)); }
+	int32_4(float_4 a) { v = _mm_cvttps_epi32(a.v); }
+};
+
+inline float_4 float_4::cast(int32_4 a) { return float_4(_mm_castsi128_ps(a.v)); }
+inline float_4::float_4(int32_4 a) { v = _mm_cvtepi32_ps(a.v); }
+
+inline float_4 operator+(float_4 a, float_4 b) { return float_4(_mm_add_ps(a.v, b.v)); }
+inline float_4 operator-(float_4 a, float_4 b) { return float_4(_mm_sub_ps(a.v, b.v)); }
+inline float_4 operator*(float_4 a, float_4 b) { return float_4(_mm_mul_ps(a.v, b.v)); }
+inline float_4 operator/(float_4 a, float_4 b) { return float_4(_mm_div_ps(a.v, b.v)); }
+inline float_4 operator&(float_4 a, float_4 b) { return float_4(_mm_and_ps(a.v, b.v)); }
+inline float_4 operator|(float_4 a, float_4 b) { return float_4(_mm_or_ps(a.v, b.v)); }
+inline float_4 operator^(float_4 a, float_4 b) { return float_4(_mm_xor_ps(a.v, b.v)); }
+inline float_4 operator==(float_4 a, float_4 b) { return float_4(_mm_cmpeq_ps(a.v, b.v)); }
+inline float_4 operator!=(float_4 a, float_4 b) { return float_4(_mm_cmpneq_ps(a.v, b.v)); }
+inline float_4 operator<(float_4 a, float_4 b) { return float_4(_mm_cmplt_ps(a.v, b.v)); }
+inline float_4 operator<=(float_4 a, float_4 b) { return float_4(_mm_cmple_ps(a.v, b.v)); }
+inline float_4 operator>(float_4 a, float_4 b) { return float_4(_mm_cmpgt_ps(a.v, b.v)); }
+inline float_4 operator>=(float_4 a, float_4 b) { return float_4(_mm_cmpge_ps(a.v, b.v)); }
+inline float_4 operator-(float_4 a) { return float_4(_mm_sub_ps(_mm_setzero_ps(), a.v)); }
+inline float_4 operator~(float_4 a) { return a ^ float_4::mask(); }
+inline float_4 &operator+=(float_4 &a, float_4 b) { return a = a + b; }
+inline float_4 &operator-=(float_4 &a, float_4 b) { return a = a - b; }
+inline float_4 &operator*=(float_4 &a, float_4 b) { return a = a * b; }
+inline float_4 &operator/=(float_4 &a, float_4 b) { return a = a / b; }
+inline float_4 &operator&=(float_4 &a, float_4 b) { return a = a & b; }
+inline float_4 &operator|=(float_4 &a, float_4 b) { return a = a | b; }
+inline float_4 &operator^=(float_4 &a, float_4 b) { return a = a ^ b; }
+
+inline int32_4 operator+(int32_4 a, int32_4 b) { return int32_4(_mm_add_epi32(a.v, b.v)); }
+inline int32_4 operator-(int32_4 a, int32_4 b) { return int32_4(_mm_sub_epi32(a.v, b.v)); }
+inline int32_4 operator*(int32_4 a, int32_4 b) { return int32_4(_mm_mullo_epi32(a.v, b.v)); }
+inline int32_4 operator&(int32_4 a, int32_4 b) { return int32_4(_mm_and_si128(a.v, b.v)); }
+inline int32_4 operator|(int32_4 a, int32_4 b) { return int32_4(_mm_or_si128(a.v, b.v)); }
+inline int32_4 operator^(int32_4 a, int32_4 b) { return int32_4(_mm_xor_si128(a.v, b.v)); }
+inline int32_4 operator<<(int32_4 a, int b) { return int32_4(_mm_slli_epi32(a.v, b)); }
+inline int32_4 operator>>(int32_4 a, int b) { return int32_4(_mm_srai_epi32(a.v, b)); }
+inline int32_4 operator==(int32_4 a, int32_4 b) { return int32_4(_mm_cmpeq_epi32(a.v, b.v)); }
+inline int32_4 operator<(int32_4 a, int32_4 b) { return int32_4(_mm_cmplt_epi32(a.v, b.v)); }
+inline int32_4 operator>(int32_4 a, int32_4 b) { return int32_4(_mm_cmpgt_epi32(a.v, b.v)); }
+inline int32_4 &operator+=(int32_4 &a, int32_4 b) { return a = a + b; }
+inline int32_4 &operator-=(int32_4 &a, int32_4 b) { return a = a - b; }
+inline int32_4 &operator&=(int32_4 &a, int32_4 b) { return a = a & b; }
+inline int32_4 &operator^=(int32_4 &a, int32_4 b) { return a = a ^ b; }
+
+// Scalar overloads so templated code can call simd:: functions with T = float
+using std::fabs;
+using std::floor;
+using std::ceil;
+using std::round;
+using std::trunc;
+using std::sqrt;
+using std::exp;
+using std::log;
+using std::pow;
+using std::sin;
+using std::cos;
+using std::tan;
+using std::fmin;
+using std::fmax;
+
+inline float ifelse(bool mask, float a, float b) { return mask ? a : b; }
+inline float clamp(float x, float a = 0.f, float b = 1.f) { return std::fmax(std::fmin(x, b), a); }
+inline int movemask(bool a) { return a ? 1 : 0; }
+
+inline float_4 ifelse(float_4 mask, float_4 a, float_4 b) { return float_4(_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))); }
+inline int movemask(float_4 a) { return _mm_movemask_ps(a.v); }
+inline float_4 fabs(float_4 x) { return float_4(_mm_andnot_ps(_mm_set1_ps(-0.f), x.v)); }
+inline float_4 fmin(float_4 a, float_4 b) { return float_4(_mm_min_ps(a.v, b.v)); }
+inline float_4 fmax(float_4 a, float_4 b) { return float_4(_mm_max_ps(a.v, b.v)); }
+inline float_4 clamp(float_4 x, float_4 a = 0.f, float_4 b = 1.f) { return fmax(fmin(x, b), a); }
+inline float_4 sqrt(float_4 x) { return float_4(_mm_sqrt_ps(x.v)); }
+inline float_4 rcp(float_4 x) { return float_4(_mm_rcp_ps(x.v)); }
+inline float_4 rsqrt(float_4 x) { return float_4(_mm_rsqrt_ps(x.v)); }
+inline float_4 floor(float_4 x) { return float_4(_mm_floor_ps(x.v)); }
+inline float_4 ceil(float_4 x) { return float_4(_mm_ceil_ps(x.v)); }
+inline float_4 round(float_4 x) { return float_4(_mm_round_ps(x.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)); }
+inline float_4 trunc(float_4 x) { return float_4(_mm_round_ps(x.v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC)); }
+inline float_4 sgn(float_4 x)
+{
+	float_4 signbit = x & -0.f;
+	float_4 nonzero = (x != 0.f);
+	return signbit | (nonzero & 1.f);
+}
+inline float_4 crossfade(float_4 a, float_4 b, float_4 p) { return a + (b - a) * p; }
+
+// Cephes exp/log/sincos, as vectorised by sse_mathfun
+inline float_4 exp(float_4 x)
+{
+	x = fmin(x, 88.3762626647949f);
+	x = fmax(x, -88.3762626647949f);
+
+	float_4 fx = x * 1.44269504088896341f + 0.5f;
+	fx = floor(fx);
+
+	x = x - fx * 0.693359375f;
+	x = x - fx * -2.12194440e-4f;
+	float_4 z = x * x;
+
+	float_4 y = 1.9875691500E-4f;
+	y = y * x + 1.3981999507E-3f;
+	y = y * x + 8.3334519073E-3f;
+	y = y * x + 4.1665795894E-2f;
+	y = y * x + 1.6666665459E-1f;
+	y = y * x + 5.0000001201E-1f;
+	y = y * z + x + 1.f;
+
+	__m128i emm0 = _mm_cvttps_epi32(fx.v);
+	emm0 = _mm_add_epi32(emm0, _mm_set1_epi32(0x7f));
+	emm0 = _mm_slli_epi32(emm0, 23);
+	return y * float_4(_mm_castsi128_ps(emm0));
+}
+
+inline float_4 log(float_4 x)
+{
+	float_4 invalid = (x <= 0.f);
+	x = fmax(x, float_4(_mm_castsi128_ps(_mm_set1_epi32(0x00800000))));
+
+	__m128i emm0 = _mm_srli_epi32(_mm_castps_si128(x.v), 23);
+	x = x & float_4(_mm_castsi128_ps(_mm_set1_epi32(~0x7f800000)));
+	x = x | 0.5f;
+	emm0 = _mm_sub_epi32(emm0, _mm_set1_epi32(0x7f));
+	float_4 e = float_4(_mm_cvtepi32_ps(emm0)) + 1.f;
+
+	float_4 mask = (x < 0.707106781186547524f);
+	float_4 tmp = x & mask;
+	x = x - 1.f;
+	e = e - (mask & 1.f);
+	x = x + tmp;
+	float_4 z = x * x;
+
+	float_4 y = 7.0376836292E-2f;
+	y = y * x - 1.1514610310E-1f;
+	y = y * x + 1.1676998740E-1f;
+	y = y * x - 1.2420140846E-1f;
+	y = y * x + 1.4249322787E-1f;
+	y = y * x - 1.6668057665E-1f;
+	y = y * x + 2.0000714765E-1f;
+	y = y * x - 2.4999993993E-1f;
+	y = y * x + 3.3333331174E-1f;
+	y = y * x * z;
+
+	y = y + e * -2.12194440e-4f;
+	y = y - z * 0.5f;
+	x = x + y + e * 0.693359375f;
+	// NaN for x <= 0
+	return x | invalid;
+}
+
+inline void sincos(float_4 x, float_4 *s, float_4 *c)
+{
+	float_4 signSin = x & -0.f;
+	x = fabs(x);
+
+	__m128i emm2 = _mm_cvttps_epi32((x * 1.27323954473516f).v);
+	emm2 = _mm_add_epi32(emm2, _mm_set1_epi32(1));
+	emm2 = _mm_and_si128(emm2, _mm_set1_epi32(~1));
+	float_4 y = float_4(_mm_cvtepi32_ps(emm2));
+	__m128i emm4 = emm2;
+
+	float_4 swapSin = float_4(_mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(emm2, _mm_set1_epi32(4)), 29)));
+	float_4 polyMask = float_4(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(emm2, _mm_set1_epi32(2)), _mm_setzero_si128())));
+
+	x = x + y * -0.78515625f;
+	x = x + y * -2.4187564849853515625e-4f;
+	x = x + y * -3.77489497744594108e-8f;
+
+	emm4 = _mm_sub_epi32(emm4, _mm_set1_epi32(2));
+	emm4 = _mm_andnot_si128(emm4, _mm_set1_epi32(4));
+	float_4 signCos = float_4(_mm_castsi128_ps(_mm_slli_epi32(emm4, 29)));
+	signSin = signSin ^ swapSin;
+
+	float_4 z = x * x;
+	float_4 yc = 2.443315711809948E-005f;
+	yc = yc * z - 1.388731625493765E-003f;
+	yc = yc * z + 4.166664568298827E-002f;
+	yc = yc * z * z - z * 0.5f + 1.f;
+
+	float_4 ys = -1.9515295891E-4f;
+	ys = ys * z + 8.3321608736E-3f;
+	ys = ys * z - 1.6666654611E-1f;
+	ys = ys * z * x + x;
+
+	*s = (ifelse(polyMask, ys, yc)) ^ signSin;
+	*c = (ifelse(polyMask, yc, ys)) ^ signCos;
+}
+
+inline float_4 sin(float_4 x)
+{
+	float_4 s, c;
+	sincos(x, &s, &c);
+	return s;
+}
+inline float_4 cos(float_4 x)
+{
+	float_4 s, c;
+	sincos(x, &s, &c);
+	return c;
+}
+inline float_4 tan(float_4 x)
+{
+	float_4 s, c;
+	sincos(x, &s, &c);
+	return s / c;
+}
+inline float_4 pow(float_4 a, float_4 b) { return exp(b * log(a)); }
+inline float_4 pow(float a, float_4 b) { return exp(b * std::log(a)); }
+
+} // namespace simd
+} // namespace rack
@@ -0,0 +1,210 @@
+// Wavetable layout micro-benchmark
+// Compares the wavetable reads of PSIOP's four operators with each operator reading its own table (as the plugin does),
+// against the four tables of a tableMatrix combination interleaved sample by sample, so sample n of every operator
+// shares a cache line
+// Only the reads are timed, there's no FM or envelopes, so the difference between layouts isn't watered down
+//
+// Usage: wavetables [-t seconds] [-n repeats]
+
+#include <rack.hpp>
+#include <chrono>
+#include "ffWavetables.hpp"
+#include "PSIOP.hpp"
+
+using namespace rack;
+using simd::float_4;
+
+static const int tableLength = 4096;
+
+// One voice's operators, their tables in both layouts, and their phase increments
+struct Voice
+{
+	const float *tables[4];
+	std::vector<float> interleaved;
+	float phases[4] = {};
+	float increments[4];
+
+	Voice(int tableIndex, int ratioIndex, float freq, float sampleRate)
+	{
+		interleaved.resize(4 * tableLength);
+		for (int i = 0; i < 4; ++i)
+		{
+			tables[i] = opalMipmaps[tableMatrix[tableIndex][i]].level(0);
+			for (int n = 0; n < tableLength; ++n)
+				interleaved[4 * n + i] = tables[i][n];
+			increments[i] = freq * fm_frequency_ratios[ratioMatrix[ratioIndex][i]] / sampleRate;
+		}
+	}
+};
+
+static float wrap(float phase)
+{
+	return phase - std::floor(phase);
+}
+
+// One operator at a time, as the scalar Operator did
+static float scalarSeparate(Voice &v)
+{
+	float out = 0.f;
+	for (int i = 0; i < 4; ++i)
+	{
+		v.phases[i] = wrap(v.phases[i] + v.increments[i]);
+		float pos = v.phases[i] * tableLength;
+		int index = pos;
+		float frac = pos - index;
+		int next = (index + 1) & (tableLength - 1);
+		out += crossfade(v.tables[i][index], v.tables[i][next], frac);
+	}
+	return out;
+}
+
+static float scalarInterleaved(Voice &v)
+{
+	float out = 0.f;
+	for (int i = 0; i < 4; ++i)
+	{
+		v.phases[i] = wrap(v.phases[i] + v.increments[i]);
+		float pos = v.phases[i] * tableLength;
+		int index = pos;
+		float frac = pos - index;
+		int next = (index + 1) & (tableLength - 1);
+		out += crossfade(v.interleaved[4 * index + i], v.interleaved[4 * next + i], frac);
+	}
+	return out;
+}
+
+// All four operators in one float_4, gathered lane by lane as Operator does
+static float simdSeparate(Voice &v)
+{
+	float_4 phase = float_4::load(v.phases);
+	phase = phase + float_4::load(v.increments);
+	phase -= simd::floor(phase);
+	phase.store(v.phases);
+
+	float_4 pos = phase * tableLength;
+	simd::int32_4 index = pos;
+	float_4 frac = pos - float_4(index);
+	simd::int32_4 next = (index + 1) & (tableLength - 1);
+	float_4 x0(v.tables[0][index[0]], v.tables[1][index[1]], v.tables[2][index[2]], v.tables[3][index[3]]);
+	float_4 x1(v.tables[0][next[0]], v.tables[1][next[1]], v.tables[2][next[2]], v.tables[3][next[3]]);
+	float_4 out = simd::crossfade(x0, x1, frac);
+	return out[0] + out[1] + out[2] + out[3];
+}
+
+static float simdInterleaved(Voice &v)
+{
+	float_4 phase = float_4::load(v.phases);
+	phase = phase + float_4::load(v.increments);
+	phase -= simd::floor(phase);
+	phase.store(v.phases);
+
+	float_4 pos = phase * tableLength;
+	simd::int32_4 index = pos;
+	float_4 frac = pos - float_4(index);
+	simd::int32_4 next = (index + 1) & (tableLength - 1);
+	const float *t = v.interleaved.data();
+	float_4 x0(t[4 * index[0]], t[4 * index[1] + 1], t[4 * index[2] + 2], t[4 * index[3] + 3]);
+	float_4 x1(t[4 * next[0]], t[4 * next[1] + 1], t[4 * next[2] + 2], t[4 * next[3] + 3]);
+	float_4 out = simd::crossfade(x0, x1, frac);
+	return out[0] + out[1] + out[2] + out[3];
+}
+
+// The best case for interleaving, every operator at the same phase so each point is a single load
+static float simdInterleavedShared(Voice &v)
+{
+	float_4 phase = float_4::load(v.phases);
+	phase = phase + float_4::load(v.increments);
+	phase -= simd::floor(phase);
+	phase.store(v.phases);
+
+	float pos = phase[0] * tableLength;
+	int index = pos;
+	float frac = pos - index;
+	int next = (index + 1) & (tableLength - 1);
+	float_4 out = simd::crossfade(float_4::load(&v.interleaved[4 * index]), float_4::load(&v.interleaved[4 * next]), frac);
+	return out[0] + out[1] + out[2] + out[3];
+}
+
+struct Case
+{
+	std::string name;
+	// tableMatrix and ratioMatrix entries for each voice
+	std::vector<std::pair<int, int>> voices;
+	bool shared;
+};
+
+typedef float (*Loop)(Voice &);
+
+// Best ns per sample (for all voices) of n runs of the given seconds at 48kHz
+static double run(const Case &c, Loop loop, double seconds, int repeats)
+{
+	const float sampleRate = 48000.f;
+	std::vector<Voice> voices;
+	for (size_t i = 0; i < c.voices.size(); ++i)
+		voices.push_back(Voice(c.voices[i].first, c.voices[i].second, 110.f * (1 + i % 4), sampleRate));
+
+	int64_t frames = seconds * sampleRate;
+	double best = INFINITY;
+	volatile float sink = 0.f;
+	for (int r = 0; r < repeats; ++r)
+	{
+		float sum = 0.f;
+		auto start = std::chrono::steady_clock::now();
+		for (int64_t f = 0; f < frames; ++f)
+		{
+			for (Voice &v : voices)
+				sum += loop(v);
+		}
+		auto end = std::chrono::steady_clock::now();
+		sink = sink + sum;
+		best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count() / frames);
+	}
+	return best;
+}
+
+int main(int argc, char *argv[])
+{
+	double seconds = 1.0;
+	int repeats = 5;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "-t" && i + 1 < argc)
+			seconds = std::atof(argv[++i]);
+		else if (arg == "-n" && i + 1 < argc)
+			repeats = std::max(1, std::atoi(argv[++i]));
+		else
+		{
+			std::printf("Usage: %s [-t seconds] [-n repeats]\n", argv[0]);
+			return 0;
+		}
+	}
+
+	_mm_setcsr(_mm_getcsr() | 0x8040);
+	initWavetables();
+
+	std::vector<Case> cases;
+	// Ratio set 0 is 1:1:1:1, so all four operators stay at the same phase
+	cases.push_back({"1 voice, equal ratios", {{10, 0}}, true});
+	cases.push_back({"1 voice, ratio set 9", {{10, 9}}, false});
+	// A drum kit, each voice with its own tables and ratios
+	Case kit = {"16 voices, mixed", {}, false};
+	for (int c = 0; c < 16; ++c)
+		kit.voices.push_back({(c * 13) % 64, (c * 7) % 32});
+	cases.push_back(kit);
+
+	std::printf("%-24s %14s %14s %14s %14s %14s\n", "ns/sample", "scalar sep", "scalar inter", "float_4 sep", "float_4 inter", "f4 inter 1ld");
+	for (const Case &c : cases)
+	{
+		std::printf("%-24s %14.1f %14.1f %14.1f %14.1f", c.name.c_str(),
+					run(c, scalarSeparate, seconds, repeats), run(c, scalarInterleaved, seconds, repeats),
+					run(c, simdSeparate, seconds, repeats), run(c, simdInterleaved, seconds, repeats));
+		if (c.shared)
+			std::printf(" %14.1f", run(c, simdInterleavedShared, seconds, repeats));
+		std::printf("\n");
+		std::fflush(stdout);
+	}
+
+	return 0;
+}
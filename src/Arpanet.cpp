@@ -7,6 +7,7 @@
 // https://indestructibletype.com/Jost.html
 
 #include "plugin.hpp"
+#include "ffCommon.hpp"
 
 struct Arpanet : Module
 {
@@ -131,6 +132,10 @@ struct Arpanet : Module
 	float outA = 0.f;
 	float outB = 0.f;
 
+	LightDivider lightDivider;
+	// Holds the clock light on if the clock went high at any point since the last light update
+	int clockLight = 0;
+
 	float getRate(float fm)
 	{
 		float rate = params[CLOCK_PARAM].getValue();
@@ -248,6 +253,12 @@ struct Arpanet : Module
 		// Get sequencer voltages
 		outA = params[SLIDER1_PARAM + indexA].getValue();
 		outB = params[SLIDER1_PARAM + indexB].getValue();
+	}
+
+	void updateLights(float deltaTime)
+	{
+		lights[CLOCK_LIGHT].setSmoothBrightness(clockLight, deltaTime);
+		clockLight = 0;
 
 		// Set position lights
 		for (int i = 0; i < 16; ++i)
@@ -323,13 +334,12 @@ struct Arpanet : Module
 
 			// Output clock
 			outputs[CLOCK_OUTPUT].setVoltage(clock * 10);
-			lights[CLOCK_LIGHT].setSmoothBrightness(clock, args.sampleTime);
+			clockLight = std::max(clockLight, clock);
 		}
 		else
 		{
 			// Choke clock output when not running
 			outputs[CLOCK_OUTPUT].setVoltage(0);
-			lights[CLOCK_LIGHT].setSmoothBrightness(0, args.sampleTime);
 		}
 
 		if (dual)
@@ -375,6 +385,11 @@ struct Arpanet : Module
 		float quantB = quantise(inputs[QUANTB_INPUT].getNormalVoltage(outB));
 		quantB += inputs[QUANTCV_INPUT].getVoltage();
 		outputs[QUANTB_OUTPUT].setVoltage(quantB);
+
+		if (lightDivider.process())
+		{
+			updateLights(lightDivider.deltaTime(args.sampleTime));
+		}
 	}
 };
 
@@ -6,6 +6,7 @@
 // https://indestructibletype.com/Jost.html
 
 #include "plugin.hpp"
+#include "ffCommon.hpp"
 
 struct Aspect : Module
 {
@@ -38,6 +39,8 @@ struct Aspect : Module
     int divisors[6] = {2, 4, 8, 16, 32, 64};
     int index = 0;
 
+    LightDivider lightDivider;
+
     Aspect()
     {
         config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
@@ -86,7 +89,6 @@ struct Aspect : Module
                 out = 10;
             }
             outputs[DIVISOR1_OUTPUT + i].setVoltage(out);
-            lights[DIVISOR1_LIGHT + i].setBrightness(out);
         }
 
         // Process gate sequencer
@@ -96,7 +98,18 @@ struct Aspect : Module
         for (int i = 0; i < 8; ++i)
         {
             outputs[SEQ1_OUTPUT + i].setVoltage(seqGates[i]);
-            lights[SEQ1_LIGHT + i].setBrightness(seqGates[i]);
+        }
+
+        if (lightDivider.process())
+        {
+            for (int i = 0; i < 6; ++i)
+            {
+                lights[DIVISOR1_LIGHT + i].setBrightness(index % divisors[i] == 0);
+            }
+            for (int i = 0; i < 8; ++i)
+            {
+                lights[SEQ1_LIGHT + i].setBrightness(i == seqIndex);
+            }
         }
     }
 };
@@ -62,6 +62,7 @@ struct Botzinger : Module
 
 	// How long each step/beat/on pulse is, as a fraction of the global rate
 	float globalRate = 0.f;
+	float rateParam = -100.f;
 	float stepLength = 0.f;
 	float beatLength = 0.f;
 	float pulseWidth = 0.f;
@@ -110,12 +111,22 @@ struct Botzinger : Module
 		pulse.reset();
 	}
 
-	void getFreeRunParameters()
+	// Only worked out again when the knob moves
+	void getGlobalRate()
 	{
 		// Expect the globalRate param to return a value -2<x<4
-		globalRate = params[RATE_PARAM].getValue();
-		// Convert to a decade scale - 10^x seconds
-		globalRate = pow(10.f, globalRate);
+		float rate = params[RATE_PARAM].getValue();
+		if (rate != rateParam)
+		{
+			rateParam = rate;
+			// Convert to a decade scale - 10^x seconds
+			globalRate = pow(10.f, rate);
+		}
+	}
+
+	void getFreeRunParameters()
+	{
+		getGlobalRate();
 
 		// stepLength is a percentage of the global rate
 		stepLength = params[TIME_PARAM + sequencer.index].getValue();
@@ -242,10 +253,7 @@ struct Botzinger : Module
 
 	void getClockedParameters()
 	{
-		// Expect the globalRate param to return a value -2<x<4
-		globalRate = params[RATE_PARAM].getValue();
-		// Convert to a decade scale - 10^x seconds
-		globalRate = pow(10.f, globalRate);
+		getGlobalRate();
 
 		// stepLength
 		stepLength = params[TIME_PARAM + sequencer.index].getValue();
@@ -8,6 +8,8 @@
 #include "plugin.hpp"
 #include "ffFilters.hpp"
 
+using simd::float_4;
+
 struct Chi : Module
 {
 	enum ParamIds
@@ -73,22 +75,47 @@ struct Chi : Module
 		configBypass(IN_INPUT, LOW_OUTPUT);
 		configBypass(IN_INPUT, MID_OUTPUT);
 		configBypass(IN_INPUT, HIGH_OUTPUT);
+
+		resetCoefficients();
+	}
+	// Channels are processed 4 at a time, one per SIMD lane
+	TLinkwitzRiley4Filter<float_4> filter[8];
+
+	// Crossover coefficients per block of 4 channels, along with the knob + CV values they were worked out from
+	// A block that sees the same values as the one before it just uses that block's coefficients
+	TLinkwitzRiley4Coefficients<float_4> lowCoeffs[4];
+	TLinkwitzRiley4Coefficients<float_4> highCoeffs[4];
+	float_4 lowXs[4];
+	float_4 highXs[4];
+
+	// Forces every block's coefficients to be worked out again
+	void resetCoefficients()
+	{
+		for (int b = 0; b < 4; ++b)
+		{
+			lowXs[b] = -1.f;
+			highXs[b] = -1.f;
+		}
+	}
+
+	void onSampleRateChange(const SampleRateChangeEvent &e) override
+	{
+		resetCoefficients();
 	}
-	LinkwitzRiley4Filter filter[32];
 
-	float lowFreqScale(float knobValue)
+	float_4 lowFreqScale(float_4 knobValue)
 	{
-		// Converts a knob value from 0 -> 0.5 -> 1 to 80 -> 225 -> 640
+		// Converts a knob value from 0 -> 0.5 -> 1 to 80 -> 225 -> 640
 		// float scaled = 540 * knobValue * knobValue + 20 * knobValue + 80;
-		float scaled = 80 * pow(8, knobValue);
+		float_4 scaled = 80 * simd::pow(8.f, knobValue);
 		return scaled;
 	}
 
-	float highFreqScale(float knobValue)
+	float_4 highFreqScale(float_4 knobValue)
 	{
-		// Converts a knob value from 0 -> 0.5 -> 1 to 1k -> 2.8k -> 8k
+		// Converts a knob value from 0 -> 0.5 -> 1 to 1k -> 2.8k -> 8k
 		// float scaled = 6800 * knobValue * knobValue + 200 * knobValue + 1000;
-		float scaled = 1000 * pow(8, knobValue);
+		float_4 scaled = 1000 * simd::pow(8.f, knobValue);
 		return scaled;
 	}
 
@@ -129,67 +156,94 @@ struct Chi : Module
 
 		int channels = inputs[IN_INPUT].getChannels();
 
-		for (int c = 0; c < channels; ++c)
+		const TLinkwitzRiley4Coefficients<float_4> *lowCoeff = NULL;
+		const TLinkwitzRiley4Coefficients<float_4> *highCoeff = NULL;
+		float_4 prevLowX = 0.f;
+		float_4 prevHighX = 0.f;
+
+		for (int c = 0; c < channels; c += 4)
 		{
-			float in = inputs[IN_INPUT].getPolyVoltage(c);
+			int b = c / 4;
+			float_4 in = inputs[IN_INPUT].getPolyVoltageSimd<float_4>(c);
 
 			/////////////// Get parameters
 
 			// Frequencies
 			// For now we're just taking MP2015 frequency ranges
 			// Start with all values [0:1]
-			float lowX = lowXParam;
-			lowX += inputs[LOW_X_INPUT].getPolyVoltage(c) / 10.f;
-			lowX = clamp(lowX, 0.f, 1.f);
-			// Convert to Hz
-			lowX = lowFreqScale(lowX);
+			float_4 lowX = lowXParam;
+			lowX += inputs[LOW_X_INPUT].getPolyVoltageSimd<float_4>(c) / 10.f;
+			lowX = simd::clamp(lowX, 0.f, 1.f);
 
 			// Start with all values [0:1]
-			float highX = highXParam;
-			highX += inputs[HIGH_X_INPUT].getPolyVoltage(c) / 10.f;
-			highX = clamp(highX, 0.f, 1.f);
-			// Convert to Hz
-			highX = highFreqScale(highX);
+			float_4 highX = highXParam;
+			highX += inputs[HIGH_X_INPUT].getPolyVoltageSimd<float_4>(c) / 10.f;
+			highX = simd::clamp(highX, 0.f, 1.f);
+
+			// Share the previous block's coefficients if all its lanes have the same values
+			// Otherwise only convert to Hz and update this block's coefficients if any lane has changed
+			if (c == 0 || simd::movemask(lowX != prevLowX))
+			{
+				if (simd::movemask(lowX != lowXs[b]))
+				{
+					// Convert to Hz
+					lowCoeffs[b].setParameters(lowFreqScale(lowX), args.sampleRate);
+					lowXs[b] = lowX;
+				}
+				lowCoeff = &lowCoeffs[b];
+			}
+			prevLowX = lowX;
+
+			if (c == 0 || simd::movemask(highX != prevHighX))
+			{
+				if (simd::movemask(highX != highXs[b]))
+				{
+					highCoeffs[b].setParameters(highFreqScale(highX), args.sampleRate);
+					highXs[b] = highX;
+				}
+				highCoeff = &highCoeffs[b];
+			}
+			prevHighX = highX;
 
 			// Gains
 			// We go up to 2.0 because we want the right hand side of the knob to be 0dB -> +6dB
 
-			float gains[3] = {0.f};
+			float_4 gains[3];
 			for (int i = 0; i < 3; ++i)
 			{
 				gains[i] = gainParams[i];
-				gains[i] += inputs[LOW_GAIN_INPUT + i].getPolyVoltage(c) * gainCVTrimParams[i];
-				gains[i] = clamp(gains[i], 0.f, 2.f);
+				gains[i] += inputs[LOW_GAIN_INPUT + i].getPolyVoltageSimd<float_4>(c) * gainCVTrimParams[i];
+				gains[i] = simd::clamp(gains[i], 0.f, 2.f);
 			}
 
 			/////////////// Process
 
-			float outs[3] = {0.f};
+			float_4 outs[3];
 
 			// Process low/mid Xover
-			filter[c * 2].process(in, lowX, args.sampleRate);
-			outs[0] = filter[c * 2].outs[0];
-			outs[1] = filter[c * 2].outs[1];
+			filter[b * 2].process(in, *lowCoeff);
+			outs[0] = filter[b * 2].outs[0];
+			outs[1] = filter[b * 2].outs[1];
 
 			// Process mid/high Xover
-			filter[c * 2 + 1].process(outs[1], highX, args.sampleRate);
-			outs[1] = filter[c * 2 + 1].outs[0];
-			outs[2] = filter[c * 2 + 1].outs[1];
+			filter[b * 2 + 1].process(outs[1], *highCoeff);
+			outs[1] = filter[b * 2 + 1].outs[0];
+			outs[2] = filter[b * 2 + 1].outs[1];
 
 			/////////////// Output
 			// Set gains and outs
 
-			float mainOut = 0.f;
+			float_4 mainOut = 0.f;
 			for (int i = 0; i < 3; ++i)
 			{
-				// Check for NaN
-				outs[i] = std::isfinite(outs[i]) ? outs[i] : 0.f;
+				// Check for NaN and inf
+				outs[i] = simd::ifelse(simd::fabs(outs[i]) < INFINITY, outs[i], 0.f);
 				outs[i] *= gains[i];
-				outputs[LOW_OUTPUT + i].setVoltage(outs[i], c);
+				outputs[LOW_OUTPUT + i].setVoltageSimd(outs[i], c);
 				mainOut += outs[i];
 			}
 
-			outputs[OUT_OUTPUT].setVoltage(mainOut, c);
+			outputs[OUT_OUTPUT].setVoltageSimd(mainOut, c);
 		}
 
 		for (int i = 0; i < NUM_OUTPUTS; ++i)
@@ -7,6 +7,7 @@
 // https://indestructibletype.com/Jost.html
 
 #include "plugin.hpp"
+#include "ffCommon.hpp"
 
 // Magic numbers for the led positions
 // These came from using tranform tools in Adobe Illustrator
@@ -116,6 +117,8 @@ struct Fax : Module
 
 	float voltages[16][32] = {{0.f}};
 
+	LightDivider lightDivider;
+
 	float getRate()
 	{
 		float rate = params[CLOCK_PARAM].getValue();
@@ -205,7 +208,10 @@ struct Fax : Module
 		{
 			out[c] = voltages[c][index];
 		}
+	}
 
+	void updateLights()
+	{
 		// Set every light to off
 		for (int i = 0; i < 32; ++i)
 		{
@@ -218,7 +224,7 @@ struct Fax : Module
 		// LEDs only represent the output voltage if in mono
 		if (channels < 2)
 		{
-			float ledValue = out[0] / 10.0;
+			float ledValue = voltages[0][index] / 10.0;
 
 			lights[LED1_LIGHT + index * 3].setBrightness(0.5 + 0.5 * -1 * ledValue);
 			lights[LED1_LIGHT + index * 3 + 1].setBrightness(0.5 + 0.5 * ledValue);
@@ -386,15 +392,16 @@ struct Fax : Module
 
 		if (recording)
 		{
-			lights[REC_LIGHT].setBrightness(1);
 			for (int c = 0; c < channels; ++c)
 			{
 				out[c] = newVolt[c];
 			}
 		}
-		else
+
+		if (lightDivider.process())
 		{
-			lights[REC_LIGHT].setBrightness(0);
+			updateLights();
+			lights[REC_LIGHT].setBrightness(recording);
 		}
 
 		for (int c = 0; c < channels; ++c)
@@ -57,9 +57,19 @@ struct Lilt : Module
 	float freq = 1.f;
 	float phaseShift = 0.f;
 
+	// Phase step per sample, only worked out again when the rate or the sample rate changes
+	float pitch = -100.f;
+	float sampleTime = 1.f / 44100.f;
+	float deltaPhase = 0.f;
+
 	void setPitch(float pitch)
 	{
-		freq = dsp::approxExp2_taylor5(pitch + 20) / 1048576;
+		if (pitch != this->pitch)
+		{
+			this->pitch = pitch;
+			freq = dsp::approxExp2_taylor5(pitch + 20) / 1048576;
+			deltaPhase = std::min(freq * sampleTime, 0.5f);
+		}
 	}
 	void setPulseWidth(float pw)
 	{
@@ -69,9 +79,8 @@ struct Lilt : Module
 	{
 		phaseShift = 1.f - shift;
 	}
-	void osc(float dt)
+	void osc()
 	{
-		float deltaPhase = fmin(freq * dt, 0.5f);
 		phase += deltaPhase;
 		if (phase >= 1.0f)
 		{
@@ -91,6 +100,13 @@ struct Lilt : Module
 		return v;
 	}
 
+	void onSampleRateChange(const SampleRateChangeEvent &e) override
+	{
+		sampleTime = e.sampleTime;
+		// Work the phase step out again on the next sample
+		pitch = -100.f;
+	}
+
 	void process(const ProcessArgs &args) override
 	{
 		float freqParam = params[ALPHA_RATE_PARAM].getValue();
@@ -114,7 +130,7 @@ struct Lilt : Module
 		setPitch(freqParam);
 		setPulseWidth(pwParam);
 		setPhaseShift(shiftParam);
-		osc(args.sampleTime);
+		osc();
 
 		float alphaOut = amplitude * alpha();
 		float betaOut = amplitude * beta();
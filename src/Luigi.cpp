@@ -6,6 +6,20 @@
 // https://indestructibletype.com/Jost.html
 
 #include "plugin.hpp"
+#include "ffCommon.hpp"
+
+using simd::float_4;
+
+// What the noise output carries
+// White is the clocked noise, the others are made every sample
+enum NoiseColour
+{
+    NOISE_WHITE,
+    NOISE_PINK,
+    NOISE_BROWN,
+    NOISE_VELVET,
+    NUM_COLOURS
+};
 
 struct Luigi : Module
 {
@@ -34,20 +48,43 @@ struct Luigi : Module
         NUM_LIGHTS
     };
 
-    dsp::SchmittTrigger clockTrigger;
-
+    // Every channel has its own clock and noise, 4 channels to a float_4
+    dsp::TSchmittTrigger<float_4> clockTriggers[4];
+    float_4 phases[4] = {};
+    // When every channel runs at the same rate they all clock together, so one phase does for all of them
     float phase = 0.f;
-    float noise = 0.f;
-    float rndClock = 0.f;
-    float dust = 0.f;
+    float_4 noises[4] = {};
+    float_4 rndClocks[4] = {};
+
+    // Internal clock rate in Hz, only worked out again when the rate in volts changes
+    float rateVolts = -100.f;
+    float clockRate = 0.f;
+    float_4 polyRateVolts[4] = {-100.f, -100.f, -100.f, -100.f};
+    float_4 polyClockRates[4] = {};
 
-    void noiseGen(float amplitude)
+    NormalGenerator4 normal;
+
+    // Coloured noise, with its own white noise as it's needed every sample rather than every clock
+    RandomGenerator4 white;
+    PinkNoise4 pinks[4];
+    BrownNoise4 browns[4];
+    VelvetNoise4 velvets[4];
+    // Samples since each lane's last clock, the velvet noise's grid follows the clock
+    float_4 sinceClock[4] = {};
+
+    // Set from the context menu
+    int channels = 1;
+    int colour = NOISE_WHITE;
+
+    // Takes a new noise value from gaussian in each lane that's been clocked, returns the dust for all of them
+    float_4 noiseGen(int b, float_4 clocked, float_4 amplitude, float_4 gaussian)
     {
-        noise = 3.f * amplitude * random::normal();
-        noise = clamp(noise, -5.f, 5.f);
-        dust = noise;
-        rndClock = noise > 0 ? 10 : 0;
-        rndClock *= amplitude;
+        float_4 noise = 3.f * amplitude * gaussian;
+        noise = simd::clamp(noise, -5.f, 5.f);
+        noises[b] = simd::ifelse(clocked, noise, noises[b]);
+        float_4 rndClock = (noise > 0.f) & (10.f * amplitude);
+        rndClocks[b] = simd::ifelse(clocked, rndClock, rndClocks[b]);
+        return clocked & noise;
     }
 
     Luigi()
@@ -66,44 +103,187 @@ struct Luigi : Module
         configOutput(NOISE_OUTPUT, "Noise");
     }
 
-    void process(const ProcessArgs &args) override
+    // Between -1 and 1
+    float_4 whiteNoise()
     {
-        float amplitude = params[AMP_PARAM].getValue();
-        amplitude += 0.1 * inputs[AMP_INPUT].getVoltage();
-        amplitude = clamp(amplitude, -1.f, 1.f);
+        return 2.f * white.uniform() - 1.f;
+    }
 
-        dust = 0.f;
-        // External Clock
-        if (inputs[CLOCK_INPUT].isConnected())
+    float_4 colouredNoise(int b, float_4 clocked, float_4 amplitude)
+    {
+        float_4 noise = 0.f;
+        switch (colour)
         {
-            if (clockTrigger.process(inputs[CLOCK_INPUT].getVoltage()))
+        case NOISE_PINK:
+            // 17 uniform sources, about 2.4 RMS
+            noise = 1.25f * pinks[b].process(whiteNoise(), whiteNoise());
+            break;
+        case NOISE_BROWN:
+            // As loud as the uniform noise going in, about 0.58 RMS
+            noise = 5.2f * browns[b].process(whiteNoise());
+            break;
+        case NOISE_VELVET:
+            sinceClock[b] += 1.f;
+            if (simd::movemask(clocked))
             {
-                noiseGen(amplitude);
+                // The next impulse goes somewhere in a period as long as the last one
+                float_4 sign = simd::ifelse(white.uniform() < 0.5f, -5.f, 5.f);
+                velvets[b].start(clocked, sinceClock[b], white.uniform(), sign);
+                sinceClock[b] = simd::ifelse(clocked, 0.f, sinceClock[b]);
             }
+            noise = velvets[b].process();
+            break;
         }
-        // Internal Clock
-        else
+        return simd::clamp(amplitude * noise, -5.f, 5.f);
+    }
+
+    void process(const ProcessArgs &args) override
+    {
+        float ampParam = params[AMP_PARAM].getValue();
+        float rateParam = params[RATE_PARAM].getValue();
+        bool external = inputs[CLOCK_INPUT].isConnected();
+
+        // The clock rate's exponential only needs working out per channel if the rate CV is polyphonic
+        // Otherwise every channel clocks at the same moments, so one phase does for all of them
+        bool polyRate = inputs[RATE_INPUT].isPolyphonic();
+        bool shared = !external && !polyRate;
+        bool sharedClocked = false;
+        if (shared)
         {
-            float rate = params[RATE_PARAM].getValue();
-            rate += inputs[RATE_INPUT].getVoltage();
-            rate = clamp(rate, 0.f, 12.f);
-            rate = 5.f * rack::dsp::approxExp2_taylor5(rate);
+            // std::min/max rather than clamp() here, clamp() uses fmin/fmax which end up as library calls
+            float volts = std::min(std::max(rateParam + inputs[RATE_INPUT].getVoltage(), 0.f), 12.f);
+            if (volts != rateVolts)
+            {
+                rateVolts = volts;
+                clockRate = 5.f * rack::dsp::approxExp2_taylor5(volts);
+            }
 
-            phase += rate * args.sampleTime;
-            if (phase >= 0.5f)
+            phase += clockRate * args.sampleTime;
+            sharedClocked = (phase >= 0.5f);
+            if (sharedClocked)
             {
                 phase -= 1.f;
-                noiseGen(amplitude);
             }
-            else if (phase <= -0.5f)
+        }
+
+        // Likewise the amplitude
+        bool polyAmp = inputs[AMP_INPUT].isPolyphonic();
+        float monoAmp = std::min(std::max(ampParam + 0.1f * inputs[AMP_INPUT].getVoltage(), -1.f), 1.f);
+
+        // Channels clocked together get their noise all at once, 16 of them is exactly one go of the generator
+        float_4 gaussians[4];
+        if (sharedClocked)
+        {
+            if (channels > 12)
+            {
+                normal.fill(gaussians);
+            }
+            else
             {
-                phase += 1.f;
+                for (int c = 0; c < channels; c += 4)
+                {
+                    gaussians[c / 4] = normal.normal();
+                }
             }
         }
 
-        outputs[RANDOM_OUTPUT].setVoltage(rndClock);
-        outputs[DUST_OUTPUT].setVoltage(dust);
-        outputs[NOISE_OUTPUT].setVoltage(noise);
+        bool randomConnected = outputs[RANDOM_OUTPUT].isConnected();
+        bool dustConnected = outputs[DUST_OUTPUT].isConnected();
+        bool noiseConnected = outputs[NOISE_OUTPUT].isConnected();
+
+        for (int c = 0; c < channels; c += 4)
+        {
+            int b = c / 4;
+
+            float_4 amplitude = monoAmp;
+            if (polyAmp)
+            {
+                amplitude = ampParam + 0.1f * inputs[AMP_INPUT].getVoltageSimd<float_4>(c);
+                amplitude = simd::clamp(amplitude, -1.f, 1.f);
+            }
+
+            float_4 clocked;
+            if (shared)
+            {
+                clocked = sharedClocked ? float_4::mask() : float_4::zero();
+            }
+            // External Clock
+            else if (external)
+            {
+                clocked = clockTriggers[b].process(inputs[CLOCK_INPUT].getPolyVoltageSimd<float_4>(c));
+            }
+            // Internal Clock, each channel at its own rate
+            else
+            {
+                float_4 volts = rateParam + inputs[RATE_INPUT].getVoltageSimd<float_4>(c);
+                volts = simd::clamp(volts, 0.f, 12.f);
+                if (simd::movemask(volts != polyRateVolts[b]))
+                {
+                    polyRateVolts[b] = volts;
+                    polyClockRates[b] = 5.f * rack::dsp::approxExp2_taylor5(volts);
+                }
+
+                phases[b] += polyClockRates[b] * args.sampleTime;
+                clocked = (phases[b] >= 0.5f);
+                phases[b] -= clocked & 1.f;
+            }
+
+            // Only draw new noise when a lane has been clocked
+            float_4 dust = 0.f;
+            if (sharedClocked)
+            {
+                dust = noiseGen(b, clocked, amplitude, gaussians[b]);
+            }
+            else if (!shared && simd::movemask(clocked))
+            {
+                dust = noiseGen(b, clocked, amplitude, normal.normal());
+            }
+
+            if (randomConnected)
+                outputs[RANDOM_OUTPUT].setVoltageSimd(rndClocks[b], c);
+            if (dustConnected)
+                outputs[DUST_OUTPUT].setVoltageSimd(dust, c);
+            if (noiseConnected)
+            {
+                if (colour == NOISE_WHITE)
+                    outputs[NOISE_OUTPUT].setVoltageSimd(noises[b], c);
+                else
+                    outputs[NOISE_OUTPUT].setVoltageSimd(colouredNoise(b, clocked, amplitude), c);
+            }
+        }
+
+        for (int i = 0; i < NUM_OUTPUTS; ++i)
+        {
+            outputs[i].setChannels(channels);
+        }
+    }
+
+    void onSampleRateChange(const SampleRateChangeEvent &e) override
+    {
+        for (int b = 0; b < 4; ++b)
+        {
+            browns[b].setSampleRate(e.sampleRate);
+        }
+    }
+
+    json_t *dataToJson() override
+    {
+        json_t *rootJ = json_object();
+        json_object_set_new(rootJ, "Channels", json_integer(channels));
+        json_object_set_new(rootJ, "Noise Colour", json_integer(colour));
+
+        return rootJ;
+    }
+
+    void dataFromJson(json_t *rootJ) override
+    {
+        json_t *channelsJ = json_object_get(rootJ, "Channels");
+        if (channelsJ)
+            channels = clamp((int)json_integer_value(channelsJ), 1, 16);
+
+        json_t *colourJ = json_object_get(rootJ, "Noise Colour");
+        if (colourJ)
+            colour = clamp((int)json_integer_value(colourJ), 0, NUM_COLOURS - 1);
     }
 };
 
@@ -130,6 +310,83 @@ struct LuigiWidget : ModuleWidget
         addOutput(createOutputCentered<FF01JKPort>(mm2px(Vec(30.789, 113.225)), module, Luigi::DUST_OUTPUT));
         addOutput(createOutputCentered<FF01JKPort>(mm2px(Vec(9.851, 113.225)), module, Luigi::NOISE_OUTPUT));
     }
+
+    void appendContextMenu(Menu *menu) override
+    {
+        Luigi *luigi = dynamic_cast<Luigi *>(module);
+        assert(luigi);
+
+        struct ChannelValueItem : MenuItem
+        {
+            Luigi *luigi;
+            int channels;
+            void onAction(const event::Action &e) override
+            {
+                luigi->channels = channels;
+            }
+        };
+
+        struct LuigiChannelsItem : MenuItem
+        {
+            Luigi *luigi;
+            Menu *createChildMenu() override
+            {
+                Menu *menu = new Menu;
+                for (int c = 1; c <= 16; ++c)
+                {
+                    ChannelValueItem *item = new ChannelValueItem;
+                    item->text = string::f("%d", c);
+                    item->rightText = CHECKMARK(luigi->channels == c);
+                    item->luigi = luigi;
+                    item->channels = c;
+                    menu->addChild(item);
+                }
+                return menu;
+            }
+        };
+
+        struct ColourValueItem : MenuItem
+        {
+            Luigi *luigi;
+            int colour;
+            void onAction(const event::Action &e) override
+            {
+                luigi->colour = colour;
+            }
+        };
+
+        struct LuigiColourItem : MenuItem
+        {
+            Luigi *luigi;
+            Menu *createChildMenu() override
+            {
+                static const std::string names[NUM_COLOURS] = {"White (clocked)", "Pink", "Brown", "Velvet"};
+                Menu *menu = new Menu;
+                for (int n = 0; n < NUM_COLOURS; ++n)
+                {
+                    ColourValueItem *item = new ColourValueItem;
+                    item->text = names[n];
+                    item->rightText = CHECKMARK(luigi->colour == n);
+                    item->luigi = luigi;
+                    item->colour = n;
+                    menu->addChild(item);
+                }
+                return menu;
+            }
+        };
+
+        menu->addChild(new MenuEntry);
+        LuigiChannelsItem *channelsItem = new LuigiChannelsItem;
+        channelsItem->text = "Polyphony Channels";
+        channelsItem->rightText = RIGHT_ARROW;
+        channelsItem->luigi = luigi;
+        menu->addChild(channelsItem);
+        LuigiColourItem *colourItem = new LuigiColourItem;
+        colourItem->text = "Noise Colour";
+        colourItem->rightText = RIGHT_ARROW;
+        colourItem->luigi = luigi;
+        menu->addChild(colourItem);
+    }
 };
 
 Model *modelLuigi = createModel<Luigi, LuigiWidget>("Luigi");
\ No newline at end of file
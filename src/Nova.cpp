@@ -7,7 +7,10 @@
 
 #include "plugin.hpp"
 #include "ffCommon.hpp"
-#include <array>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
 
 // Each sample buffer is 2097152 samples long - 47 seconds at 44.1KHz
 static const int bufferSize = 1 << 21;
@@ -100,25 +103,225 @@ static const int bufferSize = 1 << 21;
 // 	}
 // };
 
+// Sample memory is handed out in pages of 65536 samples (~1.5 seconds at 44.1KHz)
+// A buffer only holds the pages it has actually recorded into, so an idle Nova only costs the few pages its pool keeps ready
+static const int pageBits = 16;
+static const int pageSize = 1 << pageBits;
+static const int pageMask = pageSize - 1;
+static const int numPages = bufferSize / pageSize;
+
+struct SamplePage
+{
+	float samples[pageSize];
+};
+
+// Fixed size queue of pages between one producer thread and one consumer thread, neither side ever locks
+template <int N>
+struct PageQueue
+{
+	SamplePage *slots[N];
+	// Next slot to pop, only written by the consumer
+	std::atomic<int> head{0};
+	// Next slot to push, only written by the producer
+	std::atomic<int> tail{0};
+
+	bool push(SamplePage *page)
+	{
+		int t = tail.load(std::memory_order_relaxed);
+		int next = (t + 1) % N;
+		if (next == head.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		slots[t] = page;
+		tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	// Returns nullptr if the queue is empty
+	SamplePage *pop()
+	{
+		int h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+		{
+			return nullptr;
+		}
+		SamplePage *page = slots[h];
+		head.store((h + 1) % N, std::memory_order_release);
+		return page;
+	}
+
+	int size()
+	{
+		return (tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire) + N) % N;
+	}
+};
+
+// Each Nova keeps its own pool so the audio thread never goes near the allocator
+// The storage thread keeps a few pages ready to record into and frees the pages the audio thread hands back
+struct SamplePool
+{
+	// ~5 seconds of recording at 48KHz, plenty between storage thread wake ups
+	static const int maxReady = 4;
+
+	PageQueue<maxReady + 1> ready;
+	// Big enough for every page all eight slices can hold, so give() never fails
+	PageQueue<8 * numPages + 1> returned;
+
+	// Audio thread, returns nullptr if the storage thread hasn't kept up
+	SamplePage *take()
+	{
+		return ready.pop();
+	}
+
+	// Audio thread
+	void give(SamplePage *page)
+	{
+		returned.push(page);
+	}
+
+	// Storage thread, keeps a page to record into if there's room, otherwise frees it
+	void recycle(SamplePage *page)
+	{
+		if (!ready.push(page))
+		{
+			delete page;
+		}
+	}
+
+	// Storage thread, recycles returned pages into the ready queue and frees the rest
+	void service()
+	{
+		while (SamplePage *page = returned.pop())
+		{
+			recycle(page);
+		}
+		while (ready.size() < maxReady)
+		{
+			ready.push(new SamplePage);
+		}
+	}
+
+	~SamplePool()
+	{
+		while (SamplePage *page = ready.pop())
+		{
+			delete page;
+		}
+		while (SamplePage *page = returned.pop())
+		{
+			delete page;
+		}
+	}
+};
+
+// Recordings are saved as one file per slice, a short header followed by the samples
+// Samples are either 32 bit floats, or 16 bit PCM scaled to +-10V when saving compact recordings
+struct SliceHeader
+{
+	char magic[4];
+	int32_t version;
+	int32_t format;
+	int32_t length;
+	float sampleRate;
+};
+
+enum SliceFormat
+{
+	SLICE_FLOAT,
+	SLICE_PCM16
+};
+
 // Data structure for storing sampled audio
 struct SampleBuffer
 {
-	std::array<float, bufferSize> sampleBuff;
+	SamplePage *pages[numPages] = {};
 	int index = 0;
 	int length = 0;
 	int capacity = bufferSize;
 	float originalSampleRate = 0.f;
-	float currentSampleRate = 0.f;
 	bool full = false;
-	bool finished = false;
 	bool empty = true;
+	// Where pages come from on the audio thread, buffers only used off the audio thread allocate directly
+	SamplePool *pool = nullptr;
+
+	SampleBuffer() {}
+	SampleBuffer(const SampleBuffer &) = delete;
+	SampleBuffer &operator=(const SampleBuffer &) = delete;
+
+	~SampleBuffer()
+	{
+		release();
+	}
+
+	// Pointer to sample i, its page must already exist
+	float *data(int i)
+	{
+		return &pages[i >> pageBits]->samples[i & pageMask];
+	}
+
+	// Sample i, or silence either side of the recording
+	float at(int i)
+	{
+		if (i < 0 || i >= length)
+		{
+			return 0.f;
+		}
+		return *data(i);
+	}
+
+	// n samples from first onwards, straight from the page when they're all recorded and on the same page
+	// Otherwise they're gathered into scratch through at(), which gives silence either side of the recording
+	const float *read(int first, int n, float *scratch)
+	{
+		int last = first + n - 1;
+		if (first >= 0 && last < length && (first >> pageBits) == (last >> pageBits))
+		{
+			return data(first);
+		}
+		for (int t = 0; t < n; ++t)
+		{
+			scratch[t] = at(first + t);
+		}
+		return scratch;
+	}
+
+	// Hand all pages back to the pool
+	void release()
+	{
+		for (int p = 0; p < numPages; ++p)
+		{
+			if (pages[p])
+			{
+				if (pool)
+				{
+					pool->give(pages[p]);
+				}
+				else
+				{
+					delete pages[p];
+				}
+				pages[p] = nullptr;
+			}
+		}
+	}
 
 	void push(float input, float sampleRate)
 	{
 		if (index < capacity)
 		{
+			// Only grab a new page when we cross into it
+			if (!pages[index >> pageBits])
+			{
+				pages[index >> pageBits] = pool ? pool->take() : new SamplePage;
+				if (!pages[index >> pageBits])
+				{
+					// Drop the sample rather than allocate on the audio thread
+					return;
+				}
+			}
 			empty = false;
-			sampleBuff[index] = input;
+			*data(index) = input;
 			originalSampleRate = sampleRate;
 			++index;
 			++length;
@@ -131,175 +334,420 @@ struct SampleBuffer
 		}
 	}
 
-	void resetIndex(bool reversed)
+	void clear()
 	{
-		finished = false;
-
-		if (!reversed)
-		{
-			index = 0;
-		}
-		else
-		{
-			index = length - 1;
-		}
+		release();
+		reset();
 	}
 
-	void clear()
+	// Forget what's been recorded but hang on to the pages
+	void reset()
 	{
-		// sampleBuff.fill(0.f);
 		empty = true;
+		full = false;
+		index = 0;
 		length = 0;
 		originalSampleRate = 0.f;
-		currentSampleRate = 0.f;
 	}
 
-	float play(bool reversed)
+	// Trade recordings with another buffer, only the page table is touched
+	void swap(SampleBuffer &other)
 	{
-		if (finished)
-		{
-			return 0.f;
-		}
+		std::swap(pages, other.pages);
+		std::swap(index, other.index);
+		std::swap(length, other.length);
+		std::swap(originalSampleRate, other.originalSampleRate);
+		std::swap(full, other.full);
+		std::swap(empty, other.empty);
+	}
+};
+
+// Interpolation used by the playback read head
+enum Interpolation
+{
+	INTERP_LINEAR,
+	INTERP_CUBIC,
+	INTERP_SINC,
+	NUM_INTERPS
+};
+
+// Blackman windowed sinc, 8 taps, tabulated at a range of fractional offsets
+// We linearly interpolate between neighbouring rows rather than evaluating sin() per tap per sample
+struct SincTable
+{
+	static const int taps = 8;
+	static const int phases = 512;
+	float rows[phases + 1][taps];
 
-		else if (!reversed)
+	SincTable()
+	{
+		for (int p = 0; p <= phases; ++p)
 		{
-			float output = sampleBuff[index];
-			++index;
-			if (index > length - 1)
+			float frac = (float)p / phases;
+			float sum = 0.f;
+			for (int t = 0; t < taps; ++t)
 			{
-				finished = true;
+				// Tap t sits at sample (i - 3 + t), frac past sample i
+				double x = t - (taps / 2 - 1) - frac;
+				double sinc = (x == 0.0) ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+				double window = 0.42 + 0.5 * std::cos(M_PI * x / (taps / 2)) + 0.08 * std::cos(2.0 * M_PI * x / (taps / 2));
+				rows[p][t] = sinc * window;
+				sum += rows[p][t];
 			}
-			return output;
-		}
-
-		else
-		{
-			float output = sampleBuff[index];
-			--index;
-			if (index < 0)
+			// Unity gain at DC
+			for (int t = 0; t < taps; ++t)
 			{
-				finished = true;
+				rows[p][t] /= sum;
 			}
-			return output;
 		}
 	}
 };
 
+static const SincTable sincTable;
+
+// Plays back straight from the recording with a fractional read head, so pitch can change at any moment without re-rendering anything
 struct Sampler
 {
 	SampleBuffer inBuffer;
-	SampleBuffer outBuffer;
-
-	dsp::SampleRateConverter<1> inputSrc;
 
 	float output = 0.f;
-	float previousPitch = 0.f;
 
-	// Clears everything from the input and output buffers
+	// Read head position in samples, and whether it's run off either end
+	double phase = 0.0;
+	bool finished = true;
+
+	// Saving and loading to the patch storage directory happens on Nova's storage thread
+	// It holds storageMutex while it writes a recording out, the audio thread only ever try_locks it
+	std::mutex storageMutex;
+	// Bumped every time the recording is cleared, so a load that's been overtaken by a new recording gets dropped
+	std::atomic<int> generation{0};
+	// Recording has changed since it was last written
+	std::atomic<bool> dirty{false};
+	// Being recorded into right now, so not worth writing yet
+	std::atomic<bool> recordingInto{false};
+	// How much of inBuffer the audio thread has finished writing, and the pages it's in
+	// All the storage side ever reads, it never looks at inBuffer's own page table
+	std::atomic<int> committedLength{0};
+	std::atomic<float> committedSampleRate{0.f};
+	std::atomic<SamplePage *> committedPages[numPages];
+	// Pages taken away from a recording while the storage thread was writing it out
+	// They stay untouched until the storage thread frees them, the next recording starts on fresh pages
+	PageQueue<2 * numPages + 1> detached;
+	// The storage thread has loaded a recording into loadBuffer for the audio thread to pick up
+	std::atomic<bool> loaded{false};
+	SampleBuffer loadBuffer;
+	int loadGeneration = 0;
+
+	Sampler()
+	{
+		for (int p = 0; p < numPages; ++p)
+		{
+			committedPages[p].store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	~Sampler()
+	{
+		while (SamplePage *page = detached.pop())
+		{
+			delete page;
+		}
+	}
+
+	// Clears everything from the buffer
 	void clear()
 	{
-		inBuffer.clear();
-		outBuffer.clear();
+		// Bumped first so a write that's already started notices its recording went away
+		++generation;
+		committedLength.store(0, std::memory_order_release);
+		if (storageMutex.try_lock())
+		{
+			inBuffer.clear();
+			storageMutex.unlock();
+		}
+		else
+		{
+			// The storage thread is busy writing this recording out, hand it the pages to free once it's done
+			for (int p = 0; p < numPages; ++p)
+			{
+				// The queue holds more than the storage thread can fall behind by, but never record over a page it might be reading
+				if (inBuffer.pages[p] && detached.push(inBuffer.pages[p]))
+				{
+					inBuffer.pages[p] = nullptr;
+				}
+			}
+			inBuffer.reset();
+		}
+		publishPages();
+		finished = true;
+		dirty = true;
 	}
 
-	// Reset all indices ready to begin playback
-	void resetIndex(bool reverse)
+	// Storage thread, with storageMutex held
+	void freeDetached(SamplePool &pool)
 	{
-		// We reset to the end of the recorded buffer if we're about to playback in reverse
-		inBuffer.resetIndex(reverse);
-		outBuffer.resetIndex(reverse);
+		while (SamplePage *page = detached.pop())
+		{
+			pool.recycle(page);
+		}
 	}
 
-	// Convert from original sample rate a buffer was recorded at to new one determined by the pitch control
-	void convert(float pitch, float sampleRate)
+	// Writes the recording to path, or removes the file if there's nothing recorded
+	// Called with storageMutex held, only reads as far as the audio thread has committed
+	bool write(const std::string &path, bool compact)
 	{
-		previousPitch = pitch;
+		int startGeneration = generation;
+		int length = committedLength.load(std::memory_order_acquire);
+		float sampleRate = committedSampleRate.load(std::memory_order_relaxed);
+		if (length == 0)
+		{
+			system::remove(path);
+			return true;
+		}
 
-		// Clear previous outBuffer
-		outBuffer.clear();
+		// Pages stay put once we have them, clear() detaches rather than reuses them
+		SamplePage *pages[numPages];
+		for (int p = 0; p <= (length - 1) >> pageBits; ++p)
+		{
+			pages[p] = committedPages[p].load(std::memory_order_acquire);
+			if (!pages[p])
+			{
+				return false;
+			}
+		}
+		if (generation != startGeneration)
+		{
+			// Cleared while we were looking, dirty is already set so the new recording gets written next time
+			return false;
+		}
 
-		// Expecting the input paramter to be between -1.f and 1.f
-		// Produces a pitch/speed change from 1/4 to 4 times
-		float ratio = pow(4, -pitch);
+		// Write to a temporary file first so a half written slice never replaces a good one
+		std::string tempPath = path + ".tmp";
+		FILE *file = std::fopen(tempPath.c_str(), "wb");
+		if (!file)
+		{
+			return false;
+		}
 
-		// New sample rate we're converting to
-		float newRate = inBuffer.originalSampleRate * ratio;
-		outBuffer.currentSampleRate = newRate;
+		SliceHeader header = {{'N', 'O', 'V', 'A'}, 1, compact ? SLICE_PCM16 : SLICE_FLOAT, length, sampleRate};
+		bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
 
-		// Prepare sample rate converter
-		inputSrc.setRates(inBuffer.originalSampleRate, newRate);
-		int inLen = inBuffer.length + 1;
-		int outLen = std::min((int)(inLen * ratio), (int)bufferSize);
-		outBuffer.length = outLen;
+		int16_t pcm[1024];
+		for (int i = 0; ok && i < length;)
+		{
+			// Never run over the end of a page
+			int n = std::min(length - i, pageSize - (i & pageMask));
+			const float *samples = &pages[i >> pageBits]->samples[i & pageMask];
+			if (compact)
+			{
+				n = std::min(n, 1024);
+				for (int j = 0; j < n; ++j)
+				{
+					pcm[j] = (int16_t)std::round(clamp(samples[j] / 10.f, -1.f, 1.f) * 32767.f);
+				}
+				ok = std::fwrite(pcm, sizeof(int16_t), n, file) == (size_t)n;
+			}
+			else
+			{
+				ok = std::fwrite(samples, sizeof(float), n, file) == (size_t)n;
+			}
+			i += n;
+		}
 
-		// Process the sample rate conversion
-		inputSrc.process((dsp::Frame<1> *)&inBuffer.sampleBuff[0], &inLen, (dsp::Frame<1> *)&outBuffer.sampleBuff[0], &outLen);
+		ok = (std::fclose(file) == 0) && ok;
+		if (!ok || std::rename(tempPath.c_str(), path.c_str()) != 0)
+		{
+			system::remove(tempPath);
+			return false;
+		}
+		return true;
 	}
 
-	void preparePlayback(bool reverse, float pitch)
+	// Reads a recording from path into loadBuffer
+	bool read(const std::string &path)
 	{
-		resetIndex(reverse);
+		loadBuffer.clear();
+
+		FILE *file = std::fopen(path.c_str(), "rb");
+		if (!file)
+		{
+			return false;
+		}
 
-		// This should only (and always) be true after a recording has just been completed
-		// This is where we'll initially set previousPitch for this recording
-		if (outBuffer.currentSampleRate == 0.f)
+		SliceHeader header;
+		bool ok = std::fread(&header, sizeof(header), 1, file) == 1;
+		ok = ok && std::memcmp(header.magic, "NOVA", 4) == 0 && header.version == 1;
+		ok = ok && header.length > 0 && header.length <= bufferSize;
+
+		float samples[1024];
+		int16_t pcm[1024];
+		for (int i = 0; ok && i < header.length;)
 		{
-			// Just copy from the in buffer to the output without any conversion
-			if (pitch == 0.f)
+			int n = std::min(header.length - i, 1024);
+			if (header.format == SLICE_PCM16)
 			{
-				// This should copy over to the output buffer
-				inBuffer.currentSampleRate = inBuffer.originalSampleRate;
-				outBuffer = inBuffer;
-				previousPitch = 0.f;
-				return;
+				ok = std::fread(pcm, sizeof(int16_t), n, file) == (size_t)n;
+				for (int j = 0; j < n; ++j)
+				{
+					samples[j] = pcm[j] * (10.f / 32767.f);
+				}
 			}
-			// Copy into the outBuffer via sample rate conversion
 			else
 			{
-				convert(pitch, inBuffer.originalSampleRate);
-				return;
+				ok = std::fread(samples, sizeof(float), n, file) == (size_t)n;
 			}
+			for (int j = 0; ok && j < n; ++j)
+			{
+				loadBuffer.push(samples[j], header.sampleRate);
+			}
+			i += n;
 		}
-		// Output buffer has a sample rate, and it's what the pitch control says it should be
-		else if (pitch == previousPitch)
+		std::fclose(file);
+
+		if (!ok)
 		{
-			// Do nothing here, outBuffer should be correct
-			return;
+			loadBuffer.clear();
 		}
-		// Output buffer has a sample rate, but we have a new pitch value
-		else
+		return ok;
+	}
+
+	// Swap in a recording from the storage thread, as long as nothing's been recorded here in the meantime
+	void takeLoaded()
+	{
+		if (!storageMutex.try_lock())
 		{
-			convert(pitch, inBuffer.originalSampleRate);
 			return;
 		}
+		if (loadGeneration == generation && inBuffer.empty)
+		{
+			inBuffer.swap(loadBuffer);
+			publishPages();
+			commit();
+		}
+		storageMutex.unlock();
+		loaded = false;
+	}
+
+	// Move the read head to the start (or end for reversed playback)
+	void resetIndex(bool reverse)
+	{
+		phase = reverse ? inBuffer.length - 1 : 0;
+		finished = inBuffer.length == 0;
+	}
+
+	void preparePlayback(bool reverse)
+	{
+		resetIndex(reverse);
 	}
 
 	void prepareRecording()
 	{
-		// Clear both buffers
+		// Clearing also puts the record index back to the start, we always record moving forwards through the buffer
 		clear();
-		// We always record moving forwards through the buffer
-		resetIndex(false);
 	}
 
 	// Records a sample into the input buffer
 	void record(float input, float sampleRate)
 	{
+		int index = inBuffer.index;
 		inBuffer.push(input, sampleRate);
+		// Just crossed into a new page
+		if ((index & pageMask) == 0 && inBuffer.index > index)
+		{
+			committedPages[index >> pageBits].store(inBuffer.pages[index >> pageBits], std::memory_order_release);
+		}
+		commit();
+	}
+
+	// Let the storage side know where every page of the recording is
+	void publishPages()
+	{
+		for (int p = 0; p < numPages; ++p)
+		{
+			committedPages[p].store(inBuffer.pages[p], std::memory_order_release);
+		}
+	}
+
+	// Publish the recording so far to the storage side
+	void commit()
+	{
+		committedSampleRate.store(inBuffer.originalSampleRate, std::memory_order_relaxed);
+		committedLength.store(inBuffer.length, std::memory_order_release);
+	}
+
+	float interpolate(int i, float frac, int quality)
+	{
+		float scratch[SincTable::taps];
+		switch (quality)
+		{
+		case INTERP_LINEAR:
+		{
+			const float *x = inBuffer.read(i, 2, scratch);
+			return x[0] + (x[1] - x[0]) * frac;
+		}
+
+		case INTERP_CUBIC:
+		{
+			// 4 point Hermite
+			const float *x = inBuffer.read(i - 1, 4, scratch);
+			float xm1 = x[0];
+			float x0 = x[1];
+			float x1 = x[2];
+			float x2 = x[3];
+			float c1 = 0.5f * (x1 - xm1);
+			float c2 = xm1 - 2.5f * x0 + 2.f * x1 - 0.5f * x2;
+			float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+			return ((c3 * frac + c2) * frac + c1) * frac + x0;
+		}
+
+		default:
+		{
+			float pos = frac * SincTable::phases;
+			int row = (int)pos;
+			float rowFrac = pos - row;
+			const float *k0 = sincTable.rows[row];
+			const float *k1 = sincTable.rows[row + 1];
+			const float *x = inBuffer.read(i - (SincTable::taps / 2 - 1), SincTable::taps, scratch);
+			float out = 0.f;
+			for (int t = 0; t < SincTable::taps; ++t)
+			{
+				float k = k0[t] + (k1[t] - k0[t]) * rowFrac;
+				out += k * x[t];
+			}
+			return out;
+		}
+		}
 	}
 
-	// Gets the the next sample from the output buffer
-	float play(bool reverse)
+	// Gets the next sample, advancing the read head by speed samples of the original recording per engine sample
+	float play(bool reverse, float speed, float sampleTime, int quality)
 	{
-		output = outBuffer.play(reverse);
+		if (finished || phase < 0.0 || phase > inBuffer.length - 1)
+		{
+			finished = true;
+			output = 0.f;
+			return output;
+		}
+
+		int i = (int)phase;
+		float frac = phase - i;
+		output = interpolate(i, frac, quality);
+
+		// Account for the recording having been made at a different engine sample rate
+		double step = speed * inBuffer.originalSampleRate * sampleTime;
+		phase += reverse ? -step : step;
+
 		return output;
 	}
 
 	// We use this value to determine the colour of the sequencer LED during playback
 	float playheadPercent()
 	{
-		float percent = (float)outBuffer.index / (float)outBuffer.length;
-		return percent;
+		if (inBuffer.length == 0)
+		{
+			return 0.f;
+		}
+		return (float)(phase / inBuffer.length);
 	}
 };
 
@@ -346,6 +794,8 @@ struct Nova : Module
 		NUM_LIGHTS
 	};
 	Sequencer sequencer;
+	// Declared before the samplers so it outlives them, they hand their pages back to it
+	SamplePool pool;
 	Sampler samplers[8];
 	Ramp ramp;
 
@@ -365,6 +815,31 @@ struct Nova : Module
 	bool reverses[8] = {0};
 	bool skips[8] = {0};
 
+	// Playback read head interpolation, see Interpolation
+	int quality = INTERP_CUBIC;
+
+	// Playback speed from the pitch knob, only recalculated when the knob moves
+	float previousPitch = 0.f;
+	float speed = 1.f;
+
+	// Save recordings as 16 bit rather than 32 bit float
+	bool compact = false;
+
+	// Which slice is being recorded into, -1 if none
+	int recordingSlot = -1;
+
+	LightDivider lightDivider;
+
+	// Recordings are loaded and saved on this thread so big ones don't hold up the engine or the UI
+	std::thread storage;
+	std::mutex storageWakeMutex;
+	std::condition_variable storageWake;
+	std::atomic<bool> storageRunning{false};
+	// Saves ask the storage thread to write everything out and wait for it, guarded by storageWakeMutex
+	int flushRequested = 0;
+	int flushDone = 0;
+	std::condition_variable storageFlushed;
+
 	Nova()
 	{
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
@@ -375,6 +850,8 @@ struct Nova : Module
 
 		for (int i = 0; i < 8; ++i)
 		{
+			samplers[i].inBuffer.pool = &pool;
+
 			configParam(GAINS_PARAM + i, 0.f, 1.f, 1.f, string::f("Sample %d Gain", i + 1), "dB", -10.f, 20.f);
 			configSwitch(MUTES_PARAM + i, 0.f, 1.f, 0.f, string::f("Sample %d Mute", i + 1), {"Unmuted", "Muted"});
 			configSwitch(SKIPS_PARAM + i, 0.f, 1.f, 0.f, string::f("Sample %d Skip", i + 1), {"", "Skipped"});
@@ -404,6 +881,158 @@ struct Nova : Module
 		configBypass(IN_INPUT, MAINOUT_OUTPUT);
 	}
 
+	~Nova()
+	{
+		stopStorage();
+	}
+
+	void onAdd(const AddEvent &e) override
+	{
+		// Loads anything saved with the patch, then keeps the saved copies up to date
+		if (!storage.joinable())
+		{
+			// Have pages ready before the first recording, the storage thread keeps the pool topped up from here on
+			pool.service();
+			storageRunning = true;
+			storage = std::thread([this]() { storageWork(); });
+		}
+	}
+
+	void onRemove(const RemoveEvent &e) override
+	{
+		stopStorage();
+	}
+
+	void onSave(const SaveEvent &e) override
+	{
+		// Rack archives the patch storage directory as soon as this returns, so anything not written yet has to be written now
+		if (!storage.joinable())
+		{
+			writeDirty(true);
+			return;
+		}
+
+		// The storage thread has usually written most of it already, wait for it to finish off the rest
+		std::unique_lock<std::mutex> lock(storageWakeMutex);
+		int request = ++flushRequested;
+		storageWake.notify_one();
+		storageFlushed.wait(lock, [&]() { return flushDone >= request || !storageRunning; });
+	}
+
+	void stopStorage()
+	{
+		if (storage.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(storageWakeMutex);
+				storageRunning = false;
+			}
+			storageWake.notify_one();
+			storageFlushed.notify_all();
+			storage.join();
+		}
+	}
+
+	// Writes out every slice that's changed since it was last written
+	// Recordings in progress are left until they're finished, unless the patch is being saved
+	void writeDirty(bool saving)
+	{
+		for (int i = 0; i < 8; ++i)
+		{
+			Sampler &sampler = samplers[i];
+			if (sampler.dirty.exchange(false))
+			{
+				std::lock_guard<std::mutex> lock(sampler.storageMutex);
+				// Nothing is writing now, so pages cleared out from under an earlier write can go
+				sampler.freeDetached(pool);
+				// Check after locking, recording may have started since dirty was set
+				if (sampler.recordingInto)
+				{
+					// Save what we have of it, but write it again once it's finished
+					sampler.dirty = true;
+					if (!saving)
+					{
+						continue;
+					}
+				}
+				createPatchStorageDirectory();
+				sampler.write(slicePath(i), compact);
+			}
+		}
+	}
+
+	std::string slicePath(int i)
+	{
+		return system::join(getPatchStorageDirectory(), string::f("slice%d.bin", i + 1));
+	}
+
+	// Storage thread loop
+	void storageWork()
+	{
+		// Load each slice in turn, the audio thread picks them up as they arrive
+		for (int i = 0; i < 8 && storageRunning; ++i)
+		{
+			pool.service();
+			Sampler &sampler = samplers[i];
+			std::string path = slicePath(i);
+			if (!system::exists(path))
+			{
+				continue;
+			}
+			sampler.loadGeneration = sampler.generation;
+			if (sampler.read(path))
+			{
+				sampler.loaded = true;
+			}
+		}
+
+		// Write out recordings once they're finished, or straight away when the patch is saved
+		while (storageRunning)
+		{
+			int request;
+			{
+				std::lock_guard<std::mutex> lock(storageWakeMutex);
+				request = flushRequested;
+			}
+
+			pool.service();
+			for (int i = 0; i < 8; ++i)
+			{
+				// Free whatever the audio thread left in loadBuffer, either the pages it swapped out or a load it didn't want
+				if (!samplers[i].loaded)
+				{
+					samplers[i].loadBuffer.clear();
+				}
+			}
+			writeDirty(request != flushDone);
+
+			std::unique_lock<std::mutex> lock(storageWakeMutex);
+			flushDone = request;
+			storageFlushed.notify_all();
+			storageWake.wait_for(lock, std::chrono::milliseconds(250), [&]() { return !storageRunning || flushRequested != flushDone; });
+		}
+	}
+
+	json_t *dataToJson() override
+	{
+		json_t *rootJ = json_object();
+		json_object_set_new(rootJ, "Interpolation", json_integer(quality));
+		json_object_set_new(rootJ, "Compact Recordings", json_boolean(compact));
+
+		return rootJ;
+	}
+
+	void dataFromJson(json_t *rootJ) override
+	{
+		json_t *qualityJ = json_object_get(rootJ, "Interpolation");
+		if (qualityJ)
+			quality = clamp((int)json_integer_value(qualityJ), 0, NUM_INTERPS - 1);
+
+		json_t *compactJ = json_object_get(rootJ, "Compact Recordings");
+		if (compactJ)
+			compact = json_boolean_value(compactJ);
+	}
+
 	void displayLED()
 	{
 		// Set all to off
@@ -444,6 +1073,15 @@ struct Nova : Module
 
 		int jumpTo = -1;
 
+		// Pick up any recordings loaded from the patch
+		for (int i = 0; i < 8; ++i)
+		{
+			if (samplers[i].loaded)
+			{
+				samplers[i].takeLoaded();
+			}
+		}
+
 		// ENVELOPE PARAMS
 		// Get rates
 		// These are probably capable of being too fast, a lot of the knob range isn't useful
@@ -451,7 +1089,13 @@ struct Nova : Module
 		float release = params[RELEASE_PARAM].getValue();
 
 		// Get pitch change amount
+		// Produces a pitch/speed change from 1/4 to 4 times
 		float pitch = params[PITCH_PARAM].getValue();
+		if (pitch != previousPitch)
+		{
+			speed = std::pow(4.f, pitch);
+			previousPitch = pitch;
+		}
 
 		// SEQUENCER PARAMS
 		// Externally clocked only
@@ -534,8 +1178,7 @@ struct Nova : Module
 				else
 				{
 					// Still need to reset index to begin playback
-					// But here we also perform any necessary sample rate conversion
-					samplers[*index].preparePlayback(reverses[*index], pitch);
+					samplers[*index].preparePlayback(reverses[*index]);
 				}
 
 				// Reset the gain envelope
@@ -558,8 +1201,7 @@ struct Nova : Module
 				else
 				{
 					// Still need to reset index to begin playback
-					// But here we also perform an necessary sample rate conversion
-					samplers[jumpTo].preparePlayback(reverses[jumpTo], pitch);
+					samplers[jumpTo].preparePlayback(reverses[jumpTo]);
 				}
 
 				// Reset the gain envelope
@@ -583,7 +1225,7 @@ struct Nova : Module
 			else
 			{
 				// Playback
-				samplers[*index].play(reverses[*index]);
+				samplers[*index].play(reverses[*index], speed, args.sampleTime, quality);
 
 				// Process the ramp even when it's not being used because params might be changed over the playback of a long recording
 				float envelope = 1.f;
@@ -601,6 +1243,22 @@ struct Nova : Module
 			}
 		}
 
+		// Let the storage thread know which slice is being recorded, so it holds off saving it until it's finished
+		int slot = (recording && sequencer.running) ? sequencer.index : -1;
+		if (slot != recordingSlot)
+		{
+			if (recordingSlot > -1)
+			{
+				samplers[recordingSlot].recordingInto = false;
+			}
+			if (slot > -1)
+			{
+				samplers[slot].recordingInto = true;
+				samplers[slot].dirty = true;
+			}
+			recordingSlot = slot;
+		}
+
 		// Set all the individual step outs
 		for (int i = 0; i < 8; ++i)
 		{
@@ -610,11 +1268,14 @@ struct Nova : Module
 		// Set the master out
 		outputs[MAINOUT_OUTPUT].setVoltage(mainOut);
 
-		// If we're recording, turn the record light on
-		lights[REC_LIGHT].setBrightness(recording);
+		if (lightDivider.process())
+		{
+			// If we're recording, turn the record light on
+			lights[REC_LIGHT].setBrightness(recording);
 
-		// Display the LED for the current step
-		displayLED();
+			// Display the LED for the current step
+			displayLED();
+		}
 	}
 };
 
@@ -663,6 +1324,66 @@ struct NovaWidget : ModuleWidget
 			addChild(createLightCentered<MediumLight<RedGreenBlueLight>>(mm2px(Vec(61.531 + (i * deltaX), 117.503)), module, Nova::SEQS_LIGHT + (i * 3)));
 		}
 	}
+
+	void appendContextMenu(Menu *menu) override
+	{
+		Nova *nova = dynamic_cast<Nova *>(module);
+		assert(nova);
+
+		struct QualityValueItem : MenuItem
+		{
+			Nova *nova;
+			int quality;
+			void onAction(const event::Action &e) override
+			{
+				nova->quality = quality;
+			}
+		};
+
+		struct NovaQualityItem : MenuItem
+		{
+			Nova *nova;
+			Menu *createChildMenu() override
+			{
+				static const std::string names[NUM_INTERPS] = {"Linear", "Cubic", "Sinc (8 tap)"};
+				Menu *menu = new Menu;
+				for (int q = 0; q < NUM_INTERPS; ++q)
+				{
+					QualityValueItem *item = new QualityValueItem;
+					item->text = names[q];
+					item->rightText = CHECKMARK(nova->quality == q);
+					item->nova = nova;
+					item->quality = q;
+					menu->addChild(item);
+				}
+				return menu;
+			}
+		};
+
+		struct NovaCompactItem : MenuItem
+		{
+			Nova *nova;
+
+			void onAction(const event::Action &e) override
+			{
+				nova->compact = !nova->compact;
+			}
+			void step() override
+			{
+				rightText = CHECKMARK(nova->compact);
+			}
+		};
+
+		menu->addChild(new MenuEntry);
+		NovaQualityItem *novaQualityItem = new NovaQualityItem;
+		novaQualityItem->text = "Playback Interpolation";
+		novaQualityItem->rightText = RIGHT_ARROW;
+		novaQualityItem->nova = nova;
+		menu->addChild(novaQualityItem);
+		NovaCompactItem *novaCompactItem = createMenuItem<NovaCompactItem>("Save Recordings as 16 bit");
+		novaCompactItem->nova = nova;
+		menu->addChild(novaCompactItem);
+	}
 };
 
 Model *modelNova = createModel<Nova, NovaWidget>("Nova");
\ No newline at end of file
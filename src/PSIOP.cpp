@@ -7,6 +7,175 @@
 #include "PSIOP.hpp"
 #include "ffCommon.hpp"
 #include "ffFilters.hpp"
+#include <atomic>
+#include <mutex>
+
+using simd::float_4;
+
+// Everything a hit's sound depends on, as latched on trigger
+// Level and the DC filter are applied after the cache, so they aren't part of it
+struct HitKey
+{
+    float startPitch;
+    float endPitch;
+    float rates[3];
+    float feedback;
+    float index;
+    int ratioIndex;
+    int table;
+    int algo;
+    bool looping;
+    int oversample;
+
+    bool operator==(const HitKey &other) const
+    {
+        return startPitch == other.startPitch && endPitch == other.endPitch &&
+               rates[0] == other.rates[0] && rates[1] == other.rates[1] && rates[2] == other.rates[2] &&
+               feedback == other.feedback && index == other.index &&
+               ratioIndex == other.ratioIndex && table == other.table && algo == other.algo &&
+               looping == other.looping && oversample == other.oversample;
+    }
+};
+
+// The last few hits played, so a retrigger with the same parameters can be played back rather than synthesised
+// A hit is recorded the first time it plays live, and only used once it has finished
+// Hits longer than a second aren't cached
+struct HitCache
+{
+    static const int numHits = 16;
+
+    // All the hits end to end, maxLength each, allocated off the audio thread
+    struct Buffer
+    {
+        float sampleRate;
+        // Left uninitialised, so turning the cache on doesn't touch every page at once
+        std::unique_ptr<float[]> samples;
+    };
+
+    // The buffer process() records into, only the audio thread touches it
+    Buffer *buffer = nullptr;
+    float sampleRate = 0.f;
+    int maxLength = 0;
+    // Allocated for a new sample rate, waiting for the audio thread to pick it up
+    std::atomic<Buffer *> pending{nullptr};
+    // Swapped out by the audio thread, waiting to be freed off it
+    std::atomic<Buffer *> retired{nullptr};
+    // Sample rate of the last buffer allocated
+    // prepare() is called from the UI thread and from the engine's sample rate change, so it holds prepareMutex throughout
+    // The audio thread never takes it
+    std::mutex prepareMutex;
+    float preparedRate = 0.f;
+
+    HitKey keys[numHits];
+    int lengths[numHits] = {};
+    bool finished[numHits] = {};
+    // Hits that ran past maxLength, kept so they aren't recorded again every time
+    bool tooLong[numHits] = {};
+    // Voices playing or recording each hit, those hits can't be replaced
+    int users[numHits] = {};
+    uint32_t lastUsed[numHits] = {};
+    uint32_t clock = 0;
+
+    ~HitCache()
+    {
+        delete buffer;
+        delete pending.exchange(nullptr);
+        delete retired.exchange(nullptr);
+    }
+
+    // Off the audio thread, allocates a buffer for this sample rate unless there already is one
+    void prepare(float sampleRate)
+    {
+        std::lock_guard<std::mutex> lock(prepareMutex);
+        freeRetired();
+        if (sampleRate == preparedRate)
+        {
+            return;
+        }
+        preparedRate = sampleRate;
+        Buffer *prepared = new Buffer;
+        prepared->sampleRate = sampleRate;
+        prepared->samples.reset(new float[numHits * (int)sampleRate]);
+        // Replaces anything the audio thread hasn't picked up yet
+        delete pending.exchange(prepared);
+    }
+
+    // Off the audio thread
+    void freeRetired()
+    {
+        delete retired.exchange(nullptr);
+    }
+
+    // Audio thread, swaps in a newly prepared buffer once the last one has been freed
+    // Returns true when it has, every hit is forgotten
+    bool update()
+    {
+        if (!pending.load(std::memory_order_acquire) || retired.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        retired.store(buffer, std::memory_order_release);
+        buffer = pending.exchange(nullptr, std::memory_order_acq_rel);
+        sampleRate = buffer->sampleRate;
+        maxLength = sampleRate;
+        forget();
+        return true;
+    }
+
+    void forget()
+    {
+        for (int i = 0; i < numHits; ++i)
+        {
+            lengths[i] = 0;
+            finished[i] = false;
+            tooLong[i] = false;
+            users[i] = 0;
+            lastUsed[i] = 0;
+        }
+    }
+
+    float *hit(int i)
+    {
+        return &buffer->samples[i * maxLength];
+    }
+
+    // A hit with this key, finished, still recording or too long, or -1
+    int find(const HitKey &key)
+    {
+        for (int i = 0; i < numHits; ++i)
+        {
+            if ((finished[i] || tooLong[i] || users[i]) && keys[i] == key)
+            {
+                lastUsed[i] = ++clock;
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // Takes the least recently used hit nobody is using to record a new one into, or -1
+    int claim(const HitKey &key)
+    {
+        int oldest = -1;
+        for (int i = 0; i < numHits; ++i)
+        {
+            if (!users[i] && (oldest < 0 || lastUsed[i] < lastUsed[oldest]))
+            {
+                oldest = i;
+            }
+        }
+        if (oldest >= 0)
+        {
+            keys[oldest] = key;
+            lengths[oldest] = 0;
+            finished[oldest] = false;
+            tooLong[oldest] = false;
+            users[oldest] = 1;
+            lastUsed[oldest] = ++clock;
+        }
+        return oldest;
+    }
+};
 
 struct PSIOP : Module
 {
@@ -54,29 +223,58 @@ struct PSIOP : Module
         NUM_LIGHTS
     };
 
-    Operator operators[4];
-    Ramp ramps[3];
+    // Up to 16 voices, processed in blocks of 4 with one voice per SIMD lane
+    Operator operators[4][4];
+    Ramp4 ramps[4][3];
 
-    DCBlock dcBlock;
+    TDCBlock<float_4> dcBlock[4];
     bool blocking = true;  // DC filter enabled
     bool looping = false;  // Pitch envelope looping disabled
     bool indexMod = false; // Tigger level moduates FM mod index disabled
     bool sync = false;     // Operators re-sync on trigger
+    bool caching = false;  // Repeated hits played back from the render cache
+    bool cacheActive = false; // Caching, and the cache has a buffer at the engine's sample rate
+    int oversample = 1;    // Operators run at 1, 2, 4 or 8 times the engine rate
+
+    // The oversampling the decimators are set up for, oversample can be changed from the menu at any time
+    TOversamplingDecimator<float_4> decimators[4];
+    int decimatorFactor = 1;
+
+    dsp::TSchmittTrigger<float_4> trigger[4];
+    dsp::TSchmittTrigger<float_4> choke[4];
+    dsp::SchmittTrigger accent[16];
+
+    // Per voice parameters, all held on trigger
+    float_4 startPitch[4] = {};
+    float_4 endPitch[4] = {};
+    float_4 rates[4][3] = {};
+    float_4 feedback[4] = {};
+    float_4 index[4]; // Modulation index
+    float_4 level[4];
 
-    dsp::SchmittTrigger trigger;
-    dsp::SchmittTrigger choke;
-    dsp::SchmittTrigger accent;
-
-    float startPitch = 0;
-    float endPitch = 0;
-    float finePitch = 0;
-    float rates[3] = {};
-    int algo = 0;
-    int ratioIndex = 0;
-    float feedback = 0;
-    int table = 0;
-    float index = 0.6f; // Global modulation index
-    float level = 1.0f;
+    // Current pitch of each voice and its frequency in Hz
+    float_4 pitches[4] = {};
+    float_4 frequencies[4] = {dsp::FREQ_C4, dsp::FREQ_C4, dsp::FREQ_C4, dsp::FREQ_C4};
+
+    // Each voice's operator ratios and modMatrix entries for its algorithm
+    float_4 ratios[4][4];
+    float_4 modulation[4][4][5];
+
+    // Each voice's algorithm, and the one each block of 4 voices is processed with
+    // A block whose voices have different algorithms uses the generic modulation sum (-1)
+    int voiceAlgos[16] = {};
+    int blockAlgos[4] = {};
+    int algoChannels = 0;
+
+    // Render cache, and the hit each voice is playing back or recording (-1 for neither)
+    HitCache cache;
+    int playing[16];
+    int recording[16];
+    int position[16] = {};
+    // Trigger channels last time round, so voices that drop off can let go of their hits
+    int cacheChannels = 0;
+    // Engine sample rate, set on a sample rate change and read when the cache is turned on from the menu
+    std::atomic<float> sampleRate{0.f};
 
     PSIOP()
     {
@@ -111,168 +309,560 @@ struct PSIOP : Module
 
         configOutput(OUT_OUTPUT, "Main");
         configLight(OUT_LIGHT, "Output");
+
+        for (int b = 0; b < 4; ++b)
+        {
+            index[b] = 0.6f;
+            level[b] = 1.f;
+        }
+        for (int c = 0; c < 16; ++c)
+        {
+            setVoice(c, 0, 0, 0);
+            playing[c] = -1;
+            recording[c] = -1;
+        }
     }
 
-    void process(const ProcessArgs &args) override
+    // Sets up a voice's ratios, algorithm and wavetables
+    void setVoice(int c, int ratioIndex, int algo, int table)
+    {
+        int b = c / 4;
+        int lane = c % 4;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            // Actual per operator ratio to be used is taken from the LUT of magic ratios
+            ratios[b][i][lane] = fm_frequency_ratios[ratioMatrix[ratioIndex][i]];
+            operators[b][i].setTable(lane, tableMatrix[table][i]);
+
+            for (int j = 0; j < 5; ++j)
+            {
+                modulation[b][i][j][lane] = modMatrix[algo][i][j];
+            }
+        }
+        voiceAlgos[c] = algo;
+    }
+
+    void triggerVoice(int c)
+    {
+        int b = c / 4;
+        int lane = c % 4;
+
+        if (sync)
+        {
+            // Reset operators
+            for (int i = 0; i < 4; ++i)
+            {
+                operators[b][i].phase[lane] = 0.f;
+            }
+        }
+
+        // Look for accent trigger
+        if (accent[c].process(inputs[ACCENT_INPUT].getPolyVoltage(c) / 2.0f))
+        {
+            index[b][lane] = 1.f;
+            level[b][lane] = 1.8f;
+        }
+        else
+        {
+            index[b][lane] = 0.6f;
+            level[b][lane] = 1.f;
+        }
+
+        // Modulation index is determined by trigger level
+        if (indexMod)
+        {
+            index[b][lane] *= fabs(inputs[TRIGGER_INPUT].getPolyVoltage(c) / 10.f);
+        }
+
+        // Compute the start and end pitches
+        float start = params[START_PARAM].getValue();
+        start += inputs[START_INPUT].getPolyVoltage(c);
+        start += params[FINE_PARAM].getValue();
+        startPitch[b][lane] = clamp(start, -4.f, 4.f);
+
+        float end = params[END_PARAM].getValue();
+        end += inputs[END_INPUT].getPolyVoltage(c);
+        endPitch[b][lane] = clamp(end, -4.f, 4.f);
+
+        // Get the index for the ratio matrix
+        int ratioIndex = (int)params[RATIO_PARAM].getValue();
+        ratioIndex += (int)round(inputs[RATIO_INPUT].getPolyVoltage(c) * params[RATIOATTEN_PARAM].getValue());
+        ratioIndex = clamp(ratioIndex, 0, 31);
+
+        // Get the wavetable index
+        int table = (int)params[WAVE_PARAM].getValue();
+        table += (int)round(inputs[WAVE_INPUT].getPolyVoltage(c) * params[WAVEATTEN_PARAM].getValue());
+        table = clamp(table, 0, 63);
+
+        // Get the algorithim
+        int algo = (int)params[ALGO_PARAM].getValue();
+        algo += (int)round(inputs[ALGO_INPUT].getPolyVoltage(c));
+        algo = clamp(algo, 0, 5);
+
+        setVoice(c, ratioIndex, algo, table);
+        // Pick the block's kernel again
+        algoChannels = 0;
+
+        // Get the OP1 feedback amount
+        float fb = params[FB_PARAM].getValue();
+        fb += 0.2f * inputs[FB_INPUT].getPolyVoltage(c);
+        feedback[b][lane] = clamp(fb, 0.f, 1.f);
+
+        // Get the rates for the volume and pitch envelopes
+        for (int i = 0; i < 3; i++)
+        {
+            float rate = params[RATE1_PARAM + i].getValue();
+            // Special case to factor in rate 2 attenuator
+            rate += i == 1 ? 0.2 * params[RATE2ATTEN_PARAM].getValue() * inputs[RATE2_INPUT].getPolyVoltage(c) : 0.2 * inputs[RATE1_INPUT + i].getPolyVoltage(c);
+            rates[b][i][lane] = clamp(rate, 0.f, 1.f);
+        }
+
+        // Envelope times only change on a trigger
+        ramps[b][0].setRates(lane, 0.f, rates[b][0][lane]);
+        ramps[b][1].setRates(lane, 0.f, rates[b][1][lane]);
+        ramps[b][2].setRates(lane, 0.f, 1 - rates[b][2][lane]);
+
+        if (cacheActive)
+        {
+            HitKey key = {startPitch[b][lane], endPitch[b][lane], {rates[b][0][lane], rates[b][1][lane], rates[b][2][lane]}, feedback[b][lane], index[b][lane], ratioIndex, table, algo, looping, decimatorFactor};
+            if (startCachedHit(c, key))
+            {
+                return;
+            }
+        }
+
+        // Trigger
+        for (int i = 0; i < 3; i++)
+        {
+            // Set the gate for the ramps to active
+            ramps[b][i].trigger(lane);
+        }
+    }
+
+    // Stops a voice's playback or recording, an unfinished recording is thrown away
+    void stopCachedHit(int c)
+    {
+        if (playing[c] >= 0)
+        {
+            cache.users[playing[c]]--;
+            playing[c] = -1;
+        }
+        if (recording[c] >= 0)
+        {
+            cache.users[recording[c]]--;
+            recording[c] = -1;
+        }
+    }
+
+    // Plays a hit back from the cache, or starts recording it if it isn't there
+    // Returns true when the hit is played back and the voice doesn't need triggering
+    bool startCachedHit(int c, const HitKey &key)
     {
-        // Look for input on the trigger
-        // All parameters are held on trigger input
-        if (trigger.process(inputs[TRIGGER_INPUT].getVoltage() / 2.0f))
+        int b = c / 4;
+        int lane = c % 4;
+
+        stopCachedHit(c);
+
+        // Cached hits always start from silence, so every voice does
+        for (int i = 0; i < 4; ++i)
+        {
+            operators[b][i].phase[lane] = 0.f;
+            operators[b][i].out[lane] = 0.f;
+            operators[b][i].bufferSample1[lane] = 0.f;
+            operators[b][i].bufferSample2[lane] = 0.f;
+            operators[b][i].feedbackSample[lane] = 0.f;
+        }
+        for (int i = 0; i < 3; ++i)
         {
-            if (sync)
+            ramps[b][i].out[lane] = 0.f;
+            ramps[b][i].gate[lane] = 0.f;
+        }
+
+        int hit = cache.find(key);
+        if (hit >= 0 && cache.finished[hit])
+        {
+            playing[c] = hit;
+            position[c] = 0;
+            cache.users[hit]++;
+            return true;
+        }
+
+        // Another voice is already recording this hit, or it's too long to cache, so just play it live
+        if (hit < 0)
+        {
+            recording[c] = cache.claim(key);
+        }
+        return false;
+    }
+
+    // Records and plays back one block's cached hits
+    // Voices that are playing back have their output replaced, voices that are recording have it saved
+    void processCachedHits(int c, int channels, float_4 &output)
+    {
+        int soundingLanes = simd::movemask(sounding(c / 4));
+
+        for (int lane = 0; lane < 4 && c + lane < channels; ++lane)
+        {
+            int voice = c + lane;
+            if (playing[voice] >= 0)
             {
-                // Reset operators
-                for (int i = 0; i < 4; ++i)
+                int hit = playing[voice];
+                output[lane] = cache.hit(hit)[position[voice]++];
+                if (position[voice] >= cache.lengths[hit])
                 {
-                    operators[i].phase = 0.f;
+                    stopCachedHit(voice);
                 }
             }
-
-            // Look for accent trigger
-            if (accent.process(inputs[ACCENT_INPUT].getVoltage() / 2.0f))
+            else if (recording[voice] >= 0)
             {
-                index = 1.f;
-                level = 1.8f;
+                int hit = recording[voice];
+                if (!(soundingLanes & (1 << lane)))
+                {
+                    cache.finished[hit] = true;
+                    stopCachedHit(voice);
+                }
+                else if (cache.lengths[hit] < cache.maxLength)
+                {
+                    cache.hit(hit)[cache.lengths[hit]++] = output[lane];
+                }
+                else
+                {
+                    // Too long to cache, carry on live
+                    cache.tooLong[hit] = true;
+                    stopCachedHit(voice);
+                }
             }
-            else
+        }
+    }
+
+    // Lanes of a block that still need synthesising, a voice is done once both its amplitude envelopes are
+    float_4 sounding(int b)
+    {
+        return (ramps[b][0].out != 0.f) | (ramps[b][1].out != 0.f) | ramps[b][0].gate | ramps[b][1].gate;
+    }
+
+    // Picks each block's kernel, only the voices that are playing count
+    void selectAlgorithms(int channels)
+    {
+        for (int b = 0; b < 4; ++b)
+        {
+            blockAlgos[b] = voiceAlgos[b * 4];
+            for (int c = b * 4 + 1; c < std::min(b * 4 + 4, channels); ++c)
             {
-                index = 0.6f;
-                level = 1.f;
+                if (voiceAlgos[c] != blockAlgos[b])
+                {
+                    blockAlgos[b] = -1;
+                }
             }
+        }
+        algoChannels = channels;
+    }
 
-            // Modulation index is determined by trigger level
-            if (indexMod)
+    // Accumulate phase, apply FM modulation, apply appropriate amp modulation
+    // Only the block's first lanes voices are playing
+    void processOperator(int b, int i, int lanes, float_4 fmMod, float sampleTime)
+    {
+        // Feedback is applied for OP1 only
+        // Ramp 1 affects OP1 & OP3 VCA, ramp 2 affects OP2 & OP4
+        if (i == 0)
+        {
+            operators[b][i].process(sampleTime, ramps[b][0].out, fmMod, feedback[b], lanes);
+        }
+        else if (i == 2)
+        {
+            operators[b][i].process(sampleTime, ramps[b][0].out, fmMod, 0.f, lanes);
+        }
+        else
+        {
+            operators[b][i].process(sampleTime, ramps[b][1].out, fmMod, 0.f, lanes);
+        }
+    }
+
+    // One block's operators for a single algorithm, for frames samples at sampleTime
+    // Only the connections the algorithm has are done, and operators it doesn't use are skipped
+    template <int ALGO>
+    void processAlgorithm(int b, int lanes, float sampleTime, float_4 *output, int frames)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            if (operatorUsed(ALGO, i))
             {
-                index *= fabs(inputs[TRIGGER_INPUT].getVoltage() / 10.f);
+                // Set initial pitch for each operator
+                operators[b][i].setFrequency(frequencies[b]);
+                operators[b][i].applyRatio(ratios[b][i]);
             }
+        }
+
+        // FM moves the phase by a set amount each sample, so it's shared out between the frames
+        // That way oversampling doesn't change how deep the modulation is
+        float_4 fmIndex = index[b] / frames;
+
+        // Once the block's voices have died away nothing reaches the output, but the phases still have to move on
+        // OP1 is run in full so its feedback carries on just as it would have
+        bool silent = !simd::movemask(sounding(b));
+
+        for (int f = 0; f < frames; ++f)
+        {
+            output[f] = 0.f;
+
+            for (int i = 0; i < 4; i++)
+            {
+                if (!operatorUsed(ALGO, i))
+                {
+                    continue;
+                }
+                if (silent && i > 0)
+                {
+                    operators[b][i].advance(sampleTime);
+                    continue;
+                }
 
-            // Compute the start and end pitches
-            startPitch = params[START_PARAM].getValue();
-            startPitch += inputs[START_INPUT].getVoltage();
-            finePitch = params[FINE_PARAM].getValue();
-            startPitch += finePitch;
-            startPitch = clamp(startPitch, -4.f, 4.f);
+                // Determine how much operator i is modulated by other modulators j++
+                float_4 fmMod = 0.f;
+                for (int j = 0; j < 4; j++)
+                {
+                    if (modMatrix[ALGO][j][i] != 0)
+                    {
+                        fmMod += operators[b][j].out * fmIndex * modMatrix[ALGO][j][i];
+                    }
+                }
 
-            endPitch = params[END_PARAM].getValue();
-            endPitch += inputs[END_INPUT].getVoltage();
-            endPitch = clamp(endPitch, -4.f, 4.f);
+                processOperator(b, i, lanes, fmMod, sampleTime);
 
-            // Get the index for the ratio matrix
-            ratioIndex = (int)params[RATIO_PARAM].getValue();
-            ratioIndex += (int)round(inputs[RATIO_INPUT].getVoltage() * params[RATIOATTEN_PARAM].getValue());
-            ratioIndex = clamp(ratioIndex, 0, 31);
+                // Send to output as dependent on Algorithim
+                if (modMatrix[ALGO][i][4] != 0)
+                {
+                    output[f] += operators[b][i].out * modMatrix[ALGO][i][4];
+                }
+            }
+        }
+    }
 
-            // Get the wavetable index
-            table = (int)params[WAVE_PARAM].getValue();
-            table += (int)round(inputs[WAVE_INPUT].getVoltage() * params[WAVEATTEN_PARAM].getValue());
-            table = clamp(table, 0, 63);
+    // One block's operators when its voices use different algorithms
+    void processMixed(int b, int lanes, float sampleTime, float_4 *output, int frames)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            // Set initial pitch for each operator
+            operators[b][i].setFrequency(frequencies[b]);
+            operators[b][i].applyRatio(ratios[b][i]);
+        }
 
-            // Get the algorithim
-            algo = (int)params[ALGO_PARAM].getValue();
-            algo += (int)round(inputs[ALGO_INPUT].getVoltage());
-            algo = clamp(algo, 0, 5);
+        float_4 fmIndex = index[b] / frames;
+        bool silent = !simd::movemask(sounding(b));
 
-            // Get the OP1 feedback amount
-            feedback = params[FB_PARAM].getValue();
-            feedback += 0.2f * inputs[FB_INPUT].getVoltage();
-            feedback = clamp(feedback, 0.f, 1.f);
+        for (int f = 0; f < frames; ++f)
+        {
+            output[f] = 0.f;
 
-            // Get the rates for the volume and pitch envelopes
-            for (int i = 0; i < 3; i++)
+            for (int i = 0; i < 4; i++)
             {
-                rates[i] = params[RATE1_PARAM + i].getValue();
-                // Special case to factor in rate 2 attenuator
-                rates[i] += i == 1 ? 0.2 * params[RATE2ATTEN_PARAM].getValue() * inputs[RATE2_INPUT].getVoltage() : 0.2 * inputs[RATE1_INPUT + i].getVoltage();
-                rates[i] = clamp(rates[i], 0.f, 1.f);
+                if (silent && i > 0)
+                {
+                    operators[b][i].advance(sampleTime);
+                    continue;
+                }
+
+                // Determine how much operator i is modulated by other modulators j++
+                float_4 fmMod = 0.f;
+                for (int j = 0; j < 4; j++)
+                {
+                    fmMod += operators[b][j].out * fmIndex * modulation[b][j][i];
+                }
+
+                processOperator(b, i, lanes, fmMod, sampleTime);
+
+                // Send to output as dependent on Algorithim
+                output[f] += operators[b][i].out * modulation[b][i][4];
             }
+        }
+    }
+
+    // Runs a block's operators for one engine sample, oversample times over, and decimates back down
+    float_4 processOperators(int b, int lanes, float sampleTime)
+    {
+        float_4 output[8];
+        int frames = decimatorFactor;
+        float time = sampleTime / frames;
 
-            // Trigger
-            for (int i = 0; i < 3; i++)
+        switch (blockAlgos[b])
+        {
+        case 0:
+            processAlgorithm<0>(b, lanes, time, output, frames);
+            break;
+        case 1:
+            processAlgorithm<1>(b, lanes, time, output, frames);
+            break;
+        case 2:
+            processAlgorithm<2>(b, lanes, time, output, frames);
+            break;
+        case 3:
+            processAlgorithm<3>(b, lanes, time, output, frames);
+            break;
+        case 4:
+            processAlgorithm<4>(b, lanes, time, output, frames);
+            break;
+        case 5:
+            processAlgorithm<5>(b, lanes, time, output, frames);
+            break;
+        default:
+            processMixed(b, lanes, time, output, frames);
+            break;
+        }
+
+        return decimators[b].process(output, frames);
+    }
+
+    void process(const ProcessArgs &args) override
+    {
+        // One voice per trigger channel
+        int channels = std::max(1, inputs[TRIGGER_INPUT].getChannels());
+
+        // The decimators' history is at the old rate, so start them from silence
+        if (decimatorFactor != oversample)
+        {
+            decimatorFactor = oversample;
+            for (int b = 0; b < 4; ++b)
             {
-                // Set the gate for the ramps to active
-                ramps[i].gate = true;
+                decimators[b].reset();
             }
         }
 
-        // Look for Choke trigger
-        if (choke.process(inputs[CHOKE_INPUT].getVoltage() / 2.0f))
+        // Start the render cache afresh when it's turned on or off, or a buffer for a new sample rate arrives
+        // The buffer is allocated off the audio thread, see prepareCache()
+        bool swapped = cache.update();
+        bool cacheOn = caching && cache.sampleRate == args.sampleRate;
+        if (swapped || cacheOn != cacheActive)
         {
-            for (int i = 0; i < 3; i++)
+            cacheActive = cacheOn;
+            cache.forget();
+            for (int c = 0; c < 16; ++c)
             {
-                // Set the gate for the ramps to off
-                ramps[i].gate = false;
-                ramps[i].out = 0.f;
+                playing[c] = -1;
+                recording[c] = -1;
             }
         }
 
-        // Process amplitude ramps
-        for (int i = 0; i < 2; i++)
+        // Voices beyond the trigger's channels aren't processed any more, so they'd never finish with their hits
+        for (int c = channels; c < cacheChannels; ++c)
         {
-            ramps[i].process(0, 0, rates[i], args.sampleTime, false);
+            stopCachedHit(c);
         }
+        cacheChannels = channels;
 
-        // Compute current pitch as a function of pitchStart, pitchEnd and the pitch speed envelope
-        float pitch = startPitch;
-        if (rates[2] > 0.2)
+        for (int c = 0; c < channels; c += 4)
         {
-            ramps[2].process(0.3, 0, 1 - rates[2], args.sampleTime, looping);
+            int b = c / 4;
 
-            // Crossfade from start pitch to end pitch
-            float xf = ramps[2].out;
-            pitch = crossfade(endPitch, startPitch, xf);
-        }
+            // Look for input on the trigger
+            // All parameters are held on trigger input
+            int triggered = simd::movemask(trigger[b].process(inputs[TRIGGER_INPUT].getPolyVoltageSimd<float_4>(c) / 2.0f));
+            for (int lane = 0; triggered && lane < 4 && c + lane < channels; ++lane)
+            {
+                if (triggered & (1 << lane))
+                {
+                    triggerVoice(c + lane);
+                }
+            }
+            if (algoChannels != channels)
+            {
+                selectAlgorithms(channels);
+            }
 
-        // Process operators
-        float output = 0.f;
+            // Look for Choke trigger
+            float_4 choked = choke[b].process(inputs[CHOKE_INPUT].getPolyVoltageSimd<float_4>(c) / 2.0f);
+            if (simd::movemask(choked))
+            {
+                for (int i = 0; i < 3; i++)
+                {
+                    // Set the gate for the ramps to off
+                    ramps[b][i].gate &= ~choked;
+                    ramps[b][i].out = simd::ifelse(choked, 0.f, ramps[b][i].out);
+                }
+                int chokedLanes = simd::movemask(choked);
+                for (int lane = 0; cacheActive && lane < 4 && c + lane < channels; ++lane)
+                {
+                    if (chokedLanes & (1 << lane))
+                    {
+                        stopCachedHit(c + lane);
+                    }
+                }
+            }
 
-        for (int i = 0; i < 4; i++)
-        {
-            // Set initial pitch for each operator
-            operators[i].setPitch(pitch);
+            // Process amplitude ramps
+            for (int i = 0; i < 2; i++)
+            {
+                ramps[b][i].process(0, args.sampleTime, false);
+            }
 
-            // Actual per operator ratio to be used is taken from the LUT of magic ratios
-            float ratio = fm_frequency_ratios[ratioMatrix[ratioIndex][i]];
-            operators[i].applyRatio(ratio);
+            // Compute current pitch as a function of pitchStart, pitchEnd and the pitch speed envelope
+            float_4 pitch = startPitch[b];
+            float_4 pitchEnvelope = rates[b][2] > 0.2f;
+            if (simd::movemask(pitchEnvelope))
+            {
+                ramps[b][2].process(0.3, args.sampleTime, looping, pitchEnvelope);
 
-            float fmMod = 0;
+                // Crossfade from start pitch to end pitch
+                float_4 xf = ramps[b][2].out;
+                pitch = simd::ifelse(pitchEnvelope, simd::crossfade(endPitch[b], startPitch[b], xf), pitch);
+            }
 
-            // Determine how much operator i is modulated by other modulators j++
-            for (int j = 0; j < 4; j++)
+            // Only convert to Hz when the pitch has moved
+            if (simd::movemask(pitch != pitches[b]))
             {
-                fmMod += operators[j].out * index * modMatrix[algo][j][i];
+                pitches[b] = pitch;
+                // The default pitch is C4 = 261.6256f
+                frequencies[b] = dsp::FREQ_C4 * dsp::approxExp2_taylor5(pitch);
             }
 
-            // Accumulate phase, apply FM modulation, apply appropriate amp modulation
-            // Feedback is applied for OP1 only
-            // Ramp 1 affects OP1 & OP3 VCA, ramp 2 affects OP2 & OP4
-            if (i == 0)
+            // Process operators
+            float_4 output = 0.f;
+            // With the render cache on, voices always start from silence, so ones that are done or playing back can be skipped
+            if (!cacheActive || simd::movemask(sounding(b)))
             {
-                operators[i].process(args.sampleTime, ramps[0].out, fmMod, feedback, tableMatrix[table][i]);
+                output = processOperators(b, std::min(4, channels - c), args.sampleTime);
             }
-            else if (i == 2)
+
+            if (cacheActive)
             {
-                operators[i].process(args.sampleTime, ramps[0].out, fmMod, 0, tableMatrix[table][i]);
+                processCachedHits(c, channels, output);
             }
-            else
+
+            // Filter DC content from output
+            if (blocking)
             {
-                operators[i].process(args.sampleTime, ramps[1].out, fmMod, 0, tableMatrix[table][i]);
+                output = dcBlock[b].process(output);
             }
 
-            // Send to output as dependent on Algorithim
-            output += operators[i].out * modMatrix[algo][i][4];
+            // Check for NaN
+            output = simd::ifelse(simd::fabs(output) < INFINITY, output, 0.f);
+
+            // Send output signal to output jack
+            outputs[OUT_OUTPUT].setVoltageSimd(output * 3.5f * level[b], c);
         }
 
-        // Filter DC content from output
-        if (blocking)
+        outputs[OUT_OUTPUT].setChannels(channels);
+    }
+
+    void onSampleRateChange(const SampleRateChangeEvent &e) override
+    {
+        for (int b = 0; b < 4; ++b)
         {
-            output = dcBlock.process(output);
+            dcBlock[b].setSampleRate(e.sampleRate);
         }
+        sampleRate = e.sampleRate;
+        prepareCache();
+    }
 
-        // Check for NaN
-        output = std::isfinite(output) ? output : 0.f;
-
-        // Send output signal to output jack
-        outputs[OUT_OUTPUT].setVoltage(output * 3.5 * level);
+    // Allocates the render cache's buffer when caching is turned on or the sample rate changes, never from process()
+    void prepareCache()
+    {
+        float rate = sampleRate;
+        if (caching && rate > 0.f)
+        {
+            cache.prepare(rate);
+        }
     }
 
     void onReset() override
@@ -281,6 +871,8 @@ struct PSIOP : Module
         looping = false;
         indexMod = false;
         sync = false;
+        caching = false;
+        oversample = 1;
     }
 
     json_t *dataToJson() override
@@ -290,6 +882,8 @@ struct PSIOP : Module
         json_object_set_new(rootJ, "Speed Looping", json_boolean(looping));
         json_object_set_new(rootJ, "FM Index Modulation", json_boolean(indexMod));
         json_object_set_new(rootJ, "Operator Resyncing", json_boolean(sync));
+        json_object_set_new(rootJ, "Render Cache", json_boolean(caching));
+        json_object_set_new(rootJ, "Oversampling", json_integer(oversample));
 
         return rootJ;
     }
@@ -311,6 +905,20 @@ struct PSIOP : Module
         json_t *syncJ = json_object_get(rootJ, "Operator Resyncing");
         if (syncJ)
             sync = json_boolean_value(syncJ);
+
+        json_t *cacheJ = json_object_get(rootJ, "Render Cache");
+        if (cacheJ)
+        {
+            caching = json_boolean_value(cacheJ);
+            prepareCache();
+        }
+
+        json_t *oversampleJ = json_object_get(rootJ, "Oversampling");
+        if (oversampleJ)
+        {
+            int factor = json_integer_value(oversampleJ);
+            oversample = (factor == 2 || factor == 4 || factor == 8) ? factor : 1;
+        }
     }
 };
 
@@ -360,6 +968,16 @@ struct PSIOPWidget : ModuleWidget
         addChild(createLightCentered<MediumLight<RedLight>>(mm2px(Vec(74, 113.264)), module, PSIOP::OUT_LIGHT));
     }
 
+    void step() override
+    {
+        // Free the render cache buffer process() has finished with
+        if (module)
+        {
+            static_cast<PSIOP *>(module)->cache.freeRetired();
+        }
+        ModuleWidget::step();
+    }
+
     void appendContextMenu(Menu *menu) override
     {
         PSIOP *psiop = dynamic_cast<PSIOP *>(module);
@@ -421,6 +1039,50 @@ struct PSIOPWidget : ModuleWidget
             }
         };
 
+        struct PSIOPCacheItem : MenuItem
+        {
+            PSIOP *psiop;
+
+            void onAction(const event::Action &e) override
+            {
+                psiop->caching = !psiop->caching;
+                psiop->prepareCache();
+            }
+            void step() override
+            {
+                rightText = CHECKMARK(psiop->caching);
+            }
+        };
+
+        struct OversampleValueItem : MenuItem
+        {
+            PSIOP *psiop;
+            int oversample;
+            void onAction(const event::Action &e) override
+            {
+                psiop->oversample = oversample;
+            }
+        };
+
+        struct PSIOPOversampleItem : MenuItem
+        {
+            PSIOP *psiop;
+            Menu *createChildMenu() override
+            {
+                Menu *menu = new Menu;
+                for (int factor = 1; factor <= 8; factor *= 2)
+                {
+                    OversampleValueItem *item = new OversampleValueItem;
+                    item->text = factor == 1 ? "Off" : string::f("%dx", factor);
+                    item->rightText = CHECKMARK(psiop->oversample == factor);
+                    item->psiop = psiop;
+                    item->oversample = factor;
+                    menu->addChild(item);
+                }
+                return menu;
+            }
+        };
+
         menu->addChild(new MenuEntry);
         PSIOPBlockDCItem *blockDC = createMenuItem<PSIOPBlockDCItem>("DC Filter");
         blockDC->psiop = psiop;
@@ -434,6 +1096,14 @@ struct PSIOPWidget : ModuleWidget
         PSIOPSyncItem *syncOp = createMenuItem<PSIOPSyncItem>("Operators sync on trigger");
         syncOp->psiop = psiop;
         menu->addChild(syncOp);
+        PSIOPCacheItem *cacheHits = createMenuItem<PSIOPCacheItem>("Render cache for repeated hits");
+        cacheHits->psiop = psiop;
+        menu->addChild(cacheHits);
+        PSIOPOversampleItem *oversampleItem = new PSIOPOversampleItem;
+        oversampleItem->text = "Oversampling";
+        oversampleItem->rightText = RIGHT_ARROW;
+        oversampleItem->psiop = psiop;
+        menu->addChild(oversampleItem);
     }
 };
 
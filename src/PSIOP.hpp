@@ -1,6 +1,7 @@
 // 3D modulation matrix
 // 6 algorithims, 4 sources (each operators sine output), 5 destinations (each ops fm in and the master output)
-float modMatrix[6][4][5] =
+// constexpr so the per algorithm kernels in PSIOP.cpp only do the connections that exist
+constexpr float modMatrix[6][4][5] =
     {
         {{0, 1, 0, 0, 0}, {0, 0, 0, 0, 1}, {0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}},
         {{0, 0, 0, 0, 0.5}, {0, 0, 0, 0, 0.5}, {0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}},
@@ -10,6 +11,12 @@ float modMatrix[6][4][5] =
         {{0, 0, 0, 0, 0.3}, {0, 0, 1, 0, 0}, {0, 0, 0, 0, 0.3}, {0, 0, 0, 0, 0.3}},
 };
 
+// Whether an operator modulates another or reaches the output in an algorithm
+constexpr bool operatorUsed(int algo, int op)
+{
+    return modMatrix[algo][op][0] != 0 || modMatrix[algo][op][1] != 0 || modMatrix[algo][op][2] != 0 || modMatrix[algo][op][3] != 0 || modMatrix[algo][op][4] != 0;
+}
+
 // 23 Frequency ratios taken from Mutable Instruments Plaits 2 OP FM mode
 // https://github.com/pichenettes/eurorack/blob/master/plaits/resources/lookup_tables.py
 float fm_frequency_ratios[23] = {0.5f, 0.5f * pow(2.f, (16.f / 1200.0f)),
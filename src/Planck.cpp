@@ -5,6 +5,49 @@
 
 #include "plugin.hpp"
 #include "ffCommon.hpp"
+#include "ffFilters.hpp"
+
+using simd::float_4;
+
+// Dither added before the bit depth reducer rounds
+enum Dither
+{
+    DITHER_OFF,
+    DITHER_TPDF,
+    DITHER_SHAPED,
+    NUM_DITHERS
+};
+
+// Each step of the decimation amount takes off as much as one step at this rate
+static const float referenceRate = 48000.f;
+
+// Fraction of the engine rate the decimator crushes to
+// An amount of 0 is the engine rate itself, so it's a bypass at any sample rate
+// At 48kHz an amount of n holds every (n + 1)th sample as it always has, higher amounts give much the same rate whatever the engine rate
+template <typename T>
+static T crushDelta(T amount, float sampleRate)
+{
+    return 1.f / (1.f + amount * (sampleRate / referenceRate));
+}
+
+// Shows the decimation amount as the rate it crushes to
+struct CrushRateQuantity : ParamQuantity
+{
+    float getDisplayValue() override
+    {
+        float sampleRate = APP->engine->getSampleRate();
+        return sampleRate * crushDelta(getValue(), sampleRate);
+    }
+
+    void setDisplayValue(float displayValue) override
+    {
+        float sampleRate = APP->engine->getSampleRate();
+        if (displayValue > 0.f)
+        {
+            setValue(referenceRate * (1.f / displayValue - 1.f / sampleRate));
+        }
+    }
+};
 
 struct Planck : Module
 {
@@ -33,14 +76,23 @@ struct Planck : Module
         NUM_LIGHTS
     };
 
-    BitDepthReducer reducers[16];
-    SampleRateCrusher crushers[16];
+    BitDepthReducer4 reducer;
+    SampleRateCrusher4 crushers[4];
+    TOnePoleLowpass2<float_4> preFilters[4];
+
+    // Filter the crusher's input above half the rate it's crushing to
+    bool antiAliasing = false;
+
+    int dither = DITHER_OFF;
+    RandomGenerator4 ditherNoise;
+    // Each channel's last quantisation error, 4 channels to a float_4, for noise shaped dither
+    float_4 ditherErrors[4] = {};
 
     Planck()
     {
         config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
         configParam(DEPTH_PARAM, 1.f, 16.f, 16.f, "Bit Depth Reduction", "Bits");
-        configParam(RATE_PARAM, 0.f, 100.f, 0.f, "Sample Rate Decimation");
+        configParam<CrushRateQuantity>(RATE_PARAM, 0.f, 100.f, 0.f, "Sample Rate Decimation", "Hz");
 
         configInput(DEPTH_INPUT, "Bit Depth Reducer");
         configInput(DEPTH_AMT_INPUT, "Depth Reduction CV");
@@ -60,22 +112,32 @@ struct Planck : Module
         // Seperate amount of channels for the depth reducer and the rate crusher
         int depthChannels = std::max(inputs[DEPTH_INPUT].getChannels(), 1);
         // Get knob value
-        int globalDepthAmount = (int)params[DEPTH_PARAM].getValue();
+        float globalDepthAmount = (int)params[DEPTH_PARAM].getValue();
         // Array to hold output values, will be normalled to the rate crusher input
-        float depthOuts[16] = {0.f};
+        float_4 depthOuts[4] = {};
 
-        for (int c = 0; c < depthChannels; ++c)
+        for (int c = 0; c < depthChannels; c += 4)
         {
-            float depthIn = inputs[DEPTH_INPUT].getPolyVoltage(c);
+            float_4 depthIn = inputs[DEPTH_INPUT].getPolyVoltageSimd<float_4>(c);
 
             // 1V corresponds to 2^n - 1 bit depth
-            int depthAmount = globalDepthAmount;
-            depthAmount -= (int)2 * inputs[DEPTH_AMT_INPUT].getPolyVoltage(c);
-            depthAmount = clamp(depthAmount, 1, 16);
+            // Clamping before truncating gives the same whole number of bits as truncating then clamping
+            float_4 depthAmount = globalDepthAmount - 2.f * inputs[DEPTH_AMT_INPUT].getPolyVoltageSimd<float_4>(c);
+            depthAmount = simd::clamp(depthAmount, 1.f, 16.f);
             // Perform bit depth reduction
             // Clamps input to 10v pp / +-5v
-            depthOuts[c] = reducers[c].process(depthIn, depthAmount, 10.f);
-            outputs[DEPTH_OUTPUT].setVoltage(depthOuts[c], c);
+            if (dither == DITHER_OFF)
+            {
+                depthOuts[c / 4] = reducer.process(depthIn, simd::int32_4(depthAmount));
+            }
+            else
+            {
+                // Triangular dither, one step either side, from the difference of two uniform numbers
+                float_4 noise = ditherNoise.uniform() - ditherNoise.uniform();
+                float_4 *error = (dither == DITHER_SHAPED) ? &ditherErrors[c / 4] : NULL;
+                depthOuts[c / 4] = reducer.process(depthIn, simd::int32_4(depthAmount), noise, error);
+            }
+            outputs[DEPTH_OUTPUT].setVoltageSimd(depthOuts[c / 4], c);
         }
         outputs[DEPTH_OUTPUT].setChannels(depthChannels);
 
@@ -83,27 +145,54 @@ struct Planck : Module
         // Get number of channels
         int crushChannels = inputs[CRUSH_INPUT].getChannels();
         // Get knob value
-        int globalCrushAmount = (int)params[RATE_PARAM].getValue();
+        float globalCrushAmount = params[RATE_PARAM].getValue();
         // If there's nothing connected we set the number of channels to be the same as the depth reducer
         if (crushChannels == 0)
             crushChannels = depthChannels;
 
-        for (int c = 0; c < crushChannels; ++c)
+        for (int c = 0; c < crushChannels; c += 4)
         {
             // Get parameters and input
             // Normalised to depth reduction output
-            float crushIn = inputs[CRUSH_INPUT].getNormalPolyVoltage(depthOuts[c], c);
+            float_4 crushIn = inputs[CRUSH_INPUT].isConnected() ? inputs[CRUSH_INPUT].getPolyVoltageSimd<float_4>(c) : depthOuts[c / 4];
+
+            float_4 crushAmount = globalCrushAmount + 10.f * inputs[RATE_INPUT].getPolyVoltageSimd<float_4>(c);
+            crushAmount = simd::clamp(crushAmount, 0.f, 100.f);
+            float_4 delta = crushDelta(crushAmount, args.sampleRate);
+
+            if (antiAliasing)
+            {
+                // Leave the input alone in lanes that aren't being crushed
+                float_4 filtered = preFilters[c / 4].process(crushIn, delta * 0.5f);
+                crushIn = simd::ifelse(delta < 1.f, filtered, crushIn);
+            }
 
-            int crushAmount = globalCrushAmount;
-            crushAmount += (int)10 * inputs[RATE_INPUT].getPolyVoltage(c);
-            crushAmount = clamp(crushAmount, 0, 100);
             // Perfrom sample rate crushing
-            crushers[c].process(crushAmount, crushIn);
-            float crushOut = crushers[c].out;
-            outputs[CRUSH_OUTPUT].setVoltage(crushOut, c);
+            crushers[c / 4].process(delta, crushIn);
+            outputs[CRUSH_OUTPUT].setVoltageSimd(crushers[c / 4].out, c);
         }
         outputs[CRUSH_OUTPUT].setChannels(crushChannels);
     }
+
+    json_t *dataToJson() override
+    {
+        json_t *rootJ = json_object();
+        json_object_set_new(rootJ, "Anti-Aliasing", json_boolean(antiAliasing));
+        json_object_set_new(rootJ, "Dither", json_integer(dither));
+
+        return rootJ;
+    }
+
+    void dataFromJson(json_t *rootJ) override
+    {
+        json_t *antiAliasingJ = json_object_get(rootJ, "Anti-Aliasing");
+        if (antiAliasingJ)
+            antiAliasing = json_boolean_value(antiAliasingJ);
+
+        json_t *ditherJ = json_object_get(rootJ, "Dither");
+        if (ditherJ)
+            dither = clamp((int)json_integer_value(ditherJ), 0, NUM_DITHERS - 1);
+    }
 };
 
 struct PlanckWidget : ModuleWidget
@@ -129,6 +218,66 @@ struct PlanckWidget : ModuleWidget
         addOutput(createOutputCentered<FF01JKPort>(mm2px(Vec(30.757, 113.225)), module, Planck::CRUSH_OUTPUT));
         addOutput(createOutputCentered<FF01JKPort>(mm2px(Vec(9.843, 113.225)), module, Planck::DEPTH_OUTPUT));
     }
+
+    void appendContextMenu(Menu *menu) override
+    {
+        Planck *planck = dynamic_cast<Planck *>(module);
+        assert(planck);
+
+        struct PlanckAntiAliasingItem : MenuItem
+        {
+            Planck *planck;
+
+            void onAction(const event::Action &e) override
+            {
+                planck->antiAliasing = !planck->antiAliasing;
+            }
+            void step() override
+            {
+                rightText = CHECKMARK(planck->antiAliasing);
+            }
+        };
+
+        struct DitherValueItem : MenuItem
+        {
+            Planck *planck;
+            int dither;
+            void onAction(const event::Action &e) override
+            {
+                planck->dither = dither;
+            }
+        };
+
+        struct PlanckDitherItem : MenuItem
+        {
+            Planck *planck;
+            Menu *createChildMenu() override
+            {
+                static const std::string names[NUM_DITHERS] = {"Off", "TPDF", "Noise shaped"};
+                Menu *menu = new Menu;
+                for (int d = 0; d < NUM_DITHERS; ++d)
+                {
+                    DitherValueItem *item = new DitherValueItem;
+                    item->text = names[d];
+                    item->rightText = CHECKMARK(planck->dither == d);
+                    item->planck = planck;
+                    item->dither = d;
+                    menu->addChild(item);
+                }
+                return menu;
+            }
+        };
+
+        menu->addChild(new MenuEntry);
+        PlanckDitherItem *ditherItem = new PlanckDitherItem;
+        ditherItem->text = "Bit Depth Dither";
+        ditherItem->rightText = RIGHT_ARROW;
+        ditherItem->planck = planck;
+        menu->addChild(ditherItem);
+        PlanckAntiAliasingItem *antiAliasingItem = createMenuItem<PlanckAntiAliasingItem>("Anti-aliasing filter");
+        antiAliasingItem->planck = planck;
+        menu->addChild(antiAliasingItem);
+    }
 };
 
 Model *modelPlanck = createModel<Planck, PlanckWidget>("Planck");
\ No newline at end of file
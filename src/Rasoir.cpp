@@ -9,18 +9,130 @@
 #include "samplerate.h"
 #include "ffFilters.hpp"
 #include "ffCommon.hpp"
+#include <atomic>
+#include <mutex>
 
-#define HISTORY_SIZE (1 << 21)
+// Longest shift in seconds, and the longest in short shift mode
+static const float maxShift = 10.f;
+static const float maxShortShift = 0.1f;
+
+// Same as dsp::DoubleRingBuffer, but sized at runtime
+// Everything is written twice, so the samples from start onwards can always be read in one contiguous block
+struct HistoryBuffer
+{
+	std::vector<float> data;
+	size_t length = 0;
+	size_t start = 0;
+	size_t end = 0;
+
+	// Holds at least n samples, rounded up to a power of 2
+	void resize(size_t n)
+	{
+		length = 1;
+		while (length < n)
+		{
+			length <<= 1;
+		}
+		// Swap with a fresh vector, so shrinking actually gives the memory back
+		std::vector<float>(2 * length, 0.f).swap(data);
+		start = 0;
+		end = 0;
+	}
+
+	size_t mask(size_t i) const
+	{
+		return i & (length - 1);
+	}
+	void push(float t)
+	{
+		size_t i = mask(end++);
+		data[i] = t;
+		data[i + length] = t;
+	}
+	bool full() const
+	{
+		return end - start >= length;
+	}
+	size_t size() const
+	{
+		return end - start;
+	}
+	const float *startData() const
+	{
+		return &data[mask(start)];
+	}
+	void startIncr(size_t n)
+	{
+		start += n;
+	}
+};
+
+// Plain ring buffer read at a fractional position behind the write head
+struct DelayLine
+{
+	std::vector<float> data;
+	size_t mask = 0;
+	size_t write = 0;
+
+	// Holds at least n samples, rounded up to a power of 2
+	void resize(size_t n)
+	{
+		size_t length = 1;
+		while (length < n)
+		{
+			length <<= 1;
+		}
+		std::vector<float>(length, 0.f).swap(data);
+		mask = length - 1;
+		write = 0;
+	}
+
+	void push(float in)
+	{
+		data[write & mask] = in;
+		++write;
+	}
+
+	// 4 point Hermite interpolated read, delay in samples, at least 2
+	float read(float delay)
+	{
+		size_t whole = (size_t)delay;
+		float frac = delay - whole;
+
+		// Reading backwards from the newest sample, so x2 is the newer side
+		size_t i = write - 1 - whole;
+		float x2 = data[(i + 1) & mask];
+		float x1 = data[i & mask];
+		float x0 = data[(i - 1) & mask];
+		float xm1 = data[(i - 2) & mask];
+
+		// Hermite between x1 (frac = 0) and x0 (frac = 1)
+		float c1 = 0.5f * (x0 - x2);
+		float c2 = x2 - 2.5f * x1 + 2.f * x0 - 0.5f * xm1;
+		float c3 = 0.5f * (xm1 - x2) + 1.5f * (x1 - x0);
+		return ((c3 * frac + c2) * frac + c1) * frac + x1;
+	}
+};
 
 struct SimpleDelay
 {
-	// From Fundamental Delay
+	// Resampling mode from Fundamental Delay
 	// https://github.com/VCVRack/Fundamental/blob/v1/src/Delay.cpp
 
-	dsp::DoubleRingBuffer<float, HISTORY_SIZE> historyBuffer;
+	HistoryBuffer historyBuffer;
 	dsp::DoubleRingBuffer<float, 16> outBuffer;
 	SRC_STATE *src = nullptr;
 
+	// Default mode, a fractional delay line whose delay time glides towards the target
+	DelayLine line;
+	float smoothDelay = 0.f;
+
+	// Shift knob range in seconds, and as an exponent so process() doesn't need a log
+	float maxDelay = maxShift;
+	float delayRange = std::log2(maxShift / 1e-3f);
+	float maxDelaySamples = 0.f;
+	bool resampling = false;
+
 	SimpleDelay()
 	{
 		src = src_new(SRC_SINC_FASTEST, 1, NULL);
@@ -32,14 +144,56 @@ struct SimpleDelay
 		src_delete(src);
 	}
 
+	// Only as much history as the longest delay needs at this sample rate, and only for the mode in use
+	// Allocates, so don't call it from process()
+	void resize(float smpRate, float longest, bool resample)
+	{
+		maxDelay = longest;
+		delayRange = std::log2(maxDelay / 1e-3f);
+		resampling = resample;
+		size_t n = (size_t)std::ceil(maxDelay * smpRate) + 4;
+
+		if (resampling)
+		{
+			historyBuffer.resize(n);
+			DelayLine().data.swap(line.data);
+			outBuffer.clear();
+			src_reset(src);
+		}
+		else
+		{
+			line.resize(n);
+			HistoryBuffer().data.swap(historyBuffer.data);
+		}
+		maxDelaySamples = n - 4;
+		smoothDelay = 0.f;
+	}
+
 	float process(float in, float delay, float smpRate)
 	{
-		float dry = in;
+		// 1ms to maxDelay, exponentially
+		delay = 1e-3f * dsp::approxExp2_taylor5(delay * delayRange);
+
+		if (resampling)
+		{
+			return resample(in, std::round(delay * smpRate));
+		}
+
+		// std::min/max rather than clamp() here, clamp() uses fmin/fmax which end up as library calls
+		float target = std::min(std::max(delay * smpRate, 2.f), maxDelaySamples);
+
+		// Glide towards the target at about the same rate the resampler catches up, but never so fast that the read head stops or runs past x10 speed
+		float change = (target - smoothDelay) * 2.3e-4f;
+		smoothDelay += std::min(std::max(change, -9.f), 0.9f);
+		smoothDelay = std::min(std::max(smoothDelay, 2.f), maxDelaySamples);
 
-		delay = 1e-3 * std::pow(10.f / 1e-3, delay);
-		// Number of delay samples
-		float index = std::round(delay * smpRate);
+		line.push(in);
+		return line.read(smoothDelay);
+	}
 
+	// Chases the target delay by resampling the history, so the shift pitches up and down as it catches up
+	float resample(float dry, float index)
+	{
 		// Push dry sample into history buffer
 		if (!historyBuffer.full())
 		{
@@ -80,6 +234,12 @@ struct SimpleDelay
 	}
 };
 
+// Both shift delays, built off the audio thread and handed to process() whole
+struct ShiftDelays
+{
+	SimpleDelay delays[2];
+};
+
 struct SlewLimiter
 {
 	// Taken from Befaco Slew Limiter
@@ -87,6 +247,11 @@ struct SlewLimiter
 
 	float out = 0.0;
 
+	// Slope per sample, only worked out again when the amount or the sample rate changes
+	float amount = -1.f;
+	float delta = 0.f;
+	float step = 0.f;
+
 	float process(float input, float amount, float delta)
 	{
 		float shape = 0.f;
@@ -97,21 +262,25 @@ struct SlewLimiter
 		// Amount of extra slew per voltage difference
 		const float shapeScale = 1 / 10.f;
 
+		// Rise and fall share the same amount
+		if (amount != this->amount || delta != this->delta)
+		{
+			this->amount = amount;
+			this->delta = delta;
+			step = slewMax * std::pow(slewMin / slewMax, amount) * delta;
+		}
+
 		// Rise
 		if (input > out)
 		{
-			float rise = amount;
-			float slew = slewMax * std::pow(slewMin / slewMax, rise);
-			out += slew * crossfade(1.f, shapeScale * (input - out), shape) * delta;
+			out += step * crossfade(1.f, shapeScale * (input - out), shape);
 			if (out > input)
 				out = input;
 		}
 		// Fall
 		else if (input < out)
 		{
-			float fall = amount;
-			float slew = slewMax * std::pow(slewMin / slewMax, fall);
-			out -= slew * crossfade(1.f, shapeScale * (out - input), shape) * delta;
+			out -= step * crossfade(1.f, shapeScale * (out - input), shape);
 			if (out < input)
 				out = input;
 		}
@@ -174,10 +343,23 @@ struct Rasoir : Module
 	};
 
 	SlewLimiter slewLims[2];
-	SimpleDelay delays[2];
+	// Only process() touches these
+	ShiftDelays *shiftDelays = nullptr;
+	// Rebuilt for new shift options, waiting for process() to pick them up
+	std::atomic<ShiftDelays *> pendingDelays{nullptr};
+	// Swapped out by process(), waiting to be freed off the audio thread
+	std::atomic<ShiftDelays *> retiredDelays{nullptr};
 
 	DCBlock dcFilter;
 
+	// Caps the shift at 100ms, so the history buffers are small enough to stay in cache
+	std::atomic<bool> shortShift{false};
+	// Chase the shift time by resampling, rather than gliding a delay line
+	std::atomic<bool> resamplingShift{false};
+	// Rebuilds happen on the UI thread and on the engine's sample rate change, so these are atomic and a rebuild holds rebuildMutex
+	std::atomic<float> sampleRate{44100.f};
+	std::mutex rebuildMutex;
+
 	Rasoir()
 	{
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
@@ -218,6 +400,70 @@ struct Rasoir : Module
 		configBypass(IN_INPUT, LOW_OUTPUT);
 		configBypass(IN_INPUT, OUT_OUTPUT);
 		configBypass(IN_INPUT, HIGH_OUTPUT);
+
+		shiftDelays = buildDelays(sampleRate, shortShift, resamplingShift);
+	}
+
+	~Rasoir()
+	{
+		delete shiftDelays;
+		delete pendingDelays.exchange(nullptr);
+		delete retiredDelays.exchange(nullptr);
+	}
+
+	// Built from one snapshot of the settings, so a rebuild never mixes old and new ones
+	ShiftDelays *buildDelays(float rate, bool isShort, bool isResampling)
+	{
+		ShiftDelays *built = new ShiftDelays;
+		for (int i = 0; i < 2; ++i)
+		{
+			built->delays[i].resize(rate, isShort ? maxShortShift : maxShift, isResampling);
+		}
+		return built;
+	}
+
+	// Call whenever the shift options or sample rate change, allocates so never from process()
+	void rebuildDelays()
+	{
+		// Whoever rebuilds last reads the latest settings and publishes last
+		std::lock_guard<std::mutex> lock(rebuildMutex);
+		freeRetiredDelays();
+		// Replaces anything process() hasn't picked up yet
+		delete pendingDelays.exchange(buildDelays(sampleRate, shortShift, resamplingShift));
+	}
+
+	void freeRetiredDelays()
+	{
+		delete retiredDelays.exchange(nullptr);
+	}
+
+	void onSampleRateChange(const SampleRateChangeEvent &e) override
+	{
+		sampleRate = e.sampleRate;
+		rebuildDelays();
+		dcFilter.setSampleRate(e.sampleRate);
+	}
+
+	json_t *dataToJson() override
+	{
+		json_t *rootJ = json_object();
+		json_object_set_new(rootJ, "Short Shift", json_boolean(shortShift));
+		json_object_set_new(rootJ, "Resampling Shift", json_boolean(resamplingShift));
+
+		return rootJ;
+	}
+
+	void dataFromJson(json_t *rootJ) override
+	{
+		json_t *shortJ = json_object_get(rootJ, "Short Shift");
+		if (shortJ)
+			shortShift = json_boolean_value(shortJ);
+
+		json_t *resamplingJ = json_object_get(rootJ, "Resampling Shift");
+		if (resamplingJ)
+			resamplingShift = json_boolean_value(resamplingJ);
+
+		rebuildDelays();
 	}
 
 	float pincher(float input, float amount)
@@ -250,6 +496,13 @@ struct Rasoir : Module
 
 	void process(const ProcessArgs &args) override
 	{
+		// Pick up delays rebuilt for new shift options, once the last ones we swapped out have been freed
+		if (pendingDelays.load(std::memory_order_acquire) && !retiredDelays.load(std::memory_order_acquire))
+		{
+			retiredDelays.store(shiftDelays, std::memory_order_release);
+			shiftDelays = pendingDelays.exchange(nullptr, std::memory_order_acq_rel);
+		}
+
 		// Get input sample
 		float input = inputs[IN_INPUT].getVoltage();
 
@@ -288,7 +541,7 @@ struct Rasoir : Module
 		// shift - taken from vcv delay
 		if (shift > 0)
 		{
-			output = delays[high].process(output, shift, args.sampleRate);
+			output = shiftDelays->delays[high].process(output, shift, args.sampleRate);
 		}
 
 		// pinch - taken from HetrickCV Waveshaper
@@ -386,6 +639,60 @@ struct RasoirWidget : ModuleWidget
 		addOutput(createOutputCentered<FF01JKPort>(mm2px(Vec(50.8, 113.225)), module, Rasoir::OUT_OUTPUT));
 		addOutput(createOutputCentered<FF01JKPort>(mm2px(Vec(75.6, 113.225)), module, Rasoir::HIGH_OUTPUT));
 	}
+
+	void step() override
+	{
+		// Free the delays process() has finished with
+		if (module)
+		{
+			static_cast<Rasoir *>(module)->freeRetiredDelays();
+		}
+		ModuleWidget::step();
+	}
+
+	void appendContextMenu(Menu *menu) override
+	{
+		Rasoir *rasoir = dynamic_cast<Rasoir *>(module);
+		assert(rasoir);
+
+		struct RasoirShortShiftItem : MenuItem
+		{
+			Rasoir *rasoir;
+
+			void onAction(const event::Action &e) override
+			{
+				rasoir->shortShift = !rasoir->shortShift;
+				rasoir->rebuildDelays();
+			}
+			void step() override
+			{
+				rightText = CHECKMARK(rasoir->shortShift);
+			}
+		};
+
+		struct RasoirResamplingItem : MenuItem
+		{
+			Rasoir *rasoir;
+
+			void onAction(const event::Action &e) override
+			{
+				rasoir->resamplingShift = !rasoir->resamplingShift;
+				rasoir->rebuildDelays();
+			}
+			void step() override
+			{
+				rightText = CHECKMARK(rasoir->resamplingShift);
+			}
+		};
+
+		menu->addChild(new MenuEntry);
+		RasoirShortShiftItem *shortShiftItem = createMenuItem<RasoirShortShiftItem>("Short Shift (100ms)");
+		shortShiftItem->rasoir = rasoir;
+		menu->addChild(shortShiftItem);
+		RasoirResamplingItem *resamplingItem = createMenuItem<RasoirResamplingItem>("Resampling Shift");
+		resamplingItem->rasoir = rasoir;
+		menu->addChild(resamplingItem);
+	}
 };
 
 Model *modelRasoir = createModel<Rasoir, RasoirWidget>("Rasoir");
\ No newline at end of file
@@ -1,4 +1,5 @@
-#include "wavetables/Wavetables.hpp"
+#include "ffWavetables.hpp"
+
 struct FFLogger
 {
     int counter = 0;
@@ -15,6 +16,288 @@ struct FFLogger
     }
 };
 
+// Lights only need updating at around the screen's frame rate, not every sample
+// Call process() once a sample and update the lights when it returns true
+struct LightDivider : dsp::ClockDivider
+{
+    LightDivider()
+    {
+        setDivision(256);
+    }
+
+    // Time between light updates, for smoothed lights
+    float deltaTime(float sampleTime)
+    {
+        return sampleTime * getDivision();
+    }
+};
+
+// Marsaglia's xorshift128 running in each simd::int32_4 lane, so one call gives 4 random numbers
+// https://www.jstatsoft.org/article/view/v008i14
+struct RandomGenerator4
+{
+    // The four words of state used as a ring, so a step only replaces the oldest rather than shuffling them all along
+    simd::int32_4 state[4];
+    int oldest = 0;
+
+    RandomGenerator4()
+    {
+        seed(random::u64());
+    }
+
+    // Fills all 16 words of state from one seed with splitmix64, which never leaves a lane all zeros in practice
+    void seed(uint64_t s)
+    {
+        int32_t words[16];
+        for (int i = 0; i < 16; i += 2)
+        {
+            s += 0x9E3779B97F4A7C15ull;
+            uint64_t r = s;
+            r = (r ^ (r >> 30)) * 0xBF58476D1CE4E5B9ull;
+            r = (r ^ (r >> 27)) * 0x94D049BB133111EBull;
+            r ^= r >> 31;
+            words[i] = (int32_t)r;
+            words[i + 1] = (int32_t)(r >> 32);
+        }
+        for (int i = 0; i < 4; ++i)
+            state[i] = simd::int32_4::load(&words[i * 4]);
+        oldest = 0;
+    }
+
+    // The shifts right have to be logical, so they're done with SSE directly
+    simd::int32_4 next()
+    {
+        simd::int32_4 x = state[oldest];
+        simd::int32_4 w = state[(oldest + 3) & 3];
+        simd::int32_4 t = x ^ (x << 11);
+        t ^= simd::int32_4(_mm_srli_epi32(t.v, 8));
+        w ^= simd::int32_4(_mm_srli_epi32(w.v, 19)) ^ t;
+        state[oldest] = w;
+        oldest = (oldest + 1) & 3;
+        return w;
+    }
+
+    // Uniform between 0 and 1, from the top 23 bits put into the mantissa of a float between 1 and 2
+    simd::float_4 uniform()
+    {
+        simd::int32_4 bits = simd::int32_4(_mm_srli_epi32(next().v, 9)) | 0x3f800000;
+        return simd::float_4::cast(bits) - 1.f;
+    }
+};
+
+// Gaussian random numbers 4 at a time, by Marsaglia and Tsang's Ziggurat method
+// https://www.jstatsoft.org/article/view/v005i08
+// About 99% of draws land in the rectangle of a layer and only cost a table lookup and a multiply
+// The rest, in the wedges or the tail, are worked out one lane at a time
+struct NormalGenerator4
+{
+    // 256 layers rather than the usual 128, so only about one draw in a hundred misses its rectangle
+    static const int layers = 256;
+    // Where the base layer's tail starts
+    static constexpr double r = 3.6541528853610088;
+
+    // One set of tables shared by every instance
+    struct Tables
+    {
+        // Each layer's threshold for the 32 bit random number, and the scale from it to x
+        // Side by side, so one load fetches both for a lane
+        float kw[layers][2];
+        // The density at the edge of each layer
+        float f[layers];
+
+        Tables()
+        {
+            const double m = 2147483648.0;
+            const double v = 4.92867323399e-3;
+            double d = r;
+            double t = d;
+            double q = v / std::exp(-0.5 * d * d);
+
+            kw[0][0] = (d / q) * m;
+            kw[1][0] = 0.f;
+            kw[0][1] = q / m;
+            kw[layers - 1][1] = d / m;
+            f[0] = 1.f;
+            f[layers - 1] = std::exp(-0.5 * d * d);
+            for (int i = layers - 2; i >= 1; --i)
+            {
+                d = std::sqrt(-2.0 * std::log(v / d + std::exp(-0.5 * d * d)));
+                kw[i + 1][0] = (d / t) * m;
+                t = d;
+                f[i] = std::exp(-0.5 * d * d);
+                kw[i][1] = d / m;
+            }
+        }
+    };
+
+    static const Tables &tables()
+    {
+        static const Tables t;
+        return t;
+    }
+
+    // Looked up once, rather than going through the static's guard on every draw
+    const Tables &t = tables();
+    RandomGenerator4 random;
+
+    // Numbers are made a few at a time, the rectangle draws in a tight loop and then the few that missed fixed up after
+    // A short block keeps the refill cheap enough not to stand out as a slow sample
+    static const int blockSize = 4;
+    simd::float_4 block[blockSize];
+    int position = blockSize;
+
+    simd::float_4 normal()
+    {
+        if (position == blockSize)
+        {
+            fill(block);
+            position = 0;
+        }
+        return block[position++];
+    }
+
+    // A whole block's worth straight into out, for when 16 channels all want a number at once
+    void fill(simd::float_4 *out)
+    {
+        simd::int32_4 draws[blockSize];
+        // One bit per lane per number, set where the draw fell outside its layer's rectangle
+        int rejected = 0;
+        for (int i = 0; i < blockSize; ++i)
+        {
+            simd::int32_4 hz = random.next();
+            simd::int32_4 iz = hz & (layers - 1);
+
+            // Two lanes' thresholds and scales to a register, then split into k and w
+            __m128 kw01 = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)t.kw[iz[0]]), (const __m64 *)t.kw[iz[1]]);
+            __m128 kw23 = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)t.kw[iz[2]]), (const __m64 *)t.kw[iz[3]]);
+            simd::float_4 k(_mm_shuffle_ps(kw01, kw23, _MM_SHUFFLE(2, 0, 2, 0)));
+            simd::float_4 w(_mm_shuffle_ps(kw01, kw23, _MM_SHUFFLE(3, 1, 3, 1)));
+            simd::float_4 h = hz;
+
+            draws[i] = hz;
+            out[i] = h * w;
+            rejected |= simd::movemask(~(simd::fabs(h) < k)) << (i * 4);
+        }
+
+        // Straight to each miss by its bit, rather than testing all 16
+        while (rejected)
+        {
+            int bit = __builtin_ctz(rejected);
+            rejected &= rejected - 1;
+            int32_t hz = draws[bit >> 2][bit & 3];
+            out[bit >> 2][bit & 3] = fix(hz, hz & (layers - 1));
+        }
+    }
+
+    // Between 0 and 1, but never 0 so it's safe to take the log of
+    static float uniformOpen()
+    {
+        return 1.f - random::uniform();
+    }
+
+    // The wedge and tail sampling for a draw that missed its layer's rectangle
+    float fix(int32_t hz, int iz)
+    {
+        while (true)
+        {
+            float x = hz * t.kw[iz][1];
+            // The base layer, sample from the tail beyond r
+            if (iz == 0)
+            {
+                float y;
+                do
+                {
+                    x = -std::log(uniformOpen()) / r;
+                    y = -std::log(uniformOpen());
+                } while (y + y < x * x);
+                return (hz > 0) ? r + x : -r - x;
+            }
+            // In the wedge, under the curve
+            if (t.f[iz] + random::uniform() * (t.f[iz - 1] - t.f[iz]) < std::exp(-0.5f * x * x))
+                return x;
+            // Start again
+            hz = (int32_t)random::u32();
+            iz = hz & (layers - 1);
+            if (std::fabs((float)hz) < t.kw[iz][0])
+                return hz * t.kw[iz][1];
+        }
+    }
+};
+
+// Voss-McCartney pink noise for 4 channels at once
+// Each sample replaces one of 16 rows of white noise, picked by the trailing zeros of a counter, so row k changes every 2^(k+1) samples
+// The rows are kept summed, so a sample costs one replacement and a couple of adds however many rows there are
+struct PinkNoise4
+{
+    simd::float_4 rows[16] = {};
+    simd::float_4 sum = 0.f;
+    uint32_t counter = 0;
+
+    // Row and white are both white noise, row replaces a row and white is added on top
+    simd::float_4 process(simd::float_4 row, simd::float_4 white)
+    {
+        ++counter;
+        // Setting bit 15 means it's never more than 15
+        int k = __builtin_ctz(counter | 0x8000);
+        sum += row - rows[k];
+        rows[k] = row;
+        // Sum from scratch every so often, so rounding errors don't build up
+        if (k == 15)
+        {
+            sum = 0.f;
+            for (int i = 0; i < 16; ++i)
+                sum += rows[i];
+        }
+        return sum + white;
+    }
+};
+
+// Brown noise for 4 channels at once, white noise through a leaky integrator
+// The leak keeps it from wandering off, below about 5Hz it's flat rather than rising forever
+// The gain keeps it at the level of the white noise going in, at any sample rate
+struct BrownNoise4
+{
+    simd::float_4 out = 0.f;
+    float leak = 0.99929f;
+    float gain = 0.03768f;
+
+    void setSampleRate(float sampleRate)
+    {
+        leak = std::exp(-2.f * float(M_PI) * 5.f / sampleRate);
+        gain = std::sqrt(1.f - leak * leak);
+    }
+
+    simd::float_4 process(simd::float_4 white)
+    {
+        out = leak * out + gain * white;
+        return out;
+    }
+};
+
+// Velvet noise for 4 channels at once, sparse impulses of random sign with one placed at random in each period of a grid
+// Each lane's grid is set by calling start() at the beginning of every period
+struct VelvetNoise4
+{
+    // Samples to go until this period's impulse, negative once it's gone
+    simd::float_4 countdown = -1.f;
+    simd::float_4 sign = 0.f;
+
+    // Starts a new period of the given length in samples in the masked lanes
+    // Position is between 0 and 1 and places the impulse in the period, sign is its polarity
+    void start(simd::float_4 mask, simd::float_4 period, simd::float_4 position, simd::float_4 sign)
+    {
+        countdown = simd::ifelse(mask, simd::floor(position * period), countdown);
+        this->sign = simd::ifelse(mask, sign, this->sign);
+    }
+
+    simd::float_4 process()
+    {
+        simd::float_4 impulse = (countdown >= 0.f) & (countdown < 1.f);
+        countdown -= 1.f;
+        return impulse & sign;
+    }
+};
+
 struct BitDepthReducer
 {
     // Powers of 2, minus 1
@@ -73,6 +356,80 @@ struct SampleRateCrusher
     }
 };
 
+// BitDepthReducer for 4 channels at once, one per simd::float_4 lane
+// The step size for each depth and its reciprocal are worked out up front, so quantising is a multiply, a round and a multiply
+struct BitDepthReducer4
+{
+    float maxVolts;
+    float stepSizes[16];
+    float reciprocals[16];
+
+    BitDepthReducer4(float range = 10.f)
+    {
+        maxVolts = range / 2.f;
+        for (int i = 0; i < 16; ++i)
+        {
+            // 2^depth - 1 steps
+            float steps = (float)((1 << (i + 1)) - 1);
+            stepSizes[i] = range / steps;
+            reciprocals[i] = steps / range;
+        }
+    }
+
+    // Depth is 1 to 16 bits in each lane
+    // Dither is added in steps before rounding
+    // If error is given, each lane's last quantisation error is taken off its next input, which pushes the error up towards high frequencies
+    simd::float_4 process(simd::float_4 in, simd::int32_4 depth, simd::float_4 dither = 0.f, simd::float_4 *error = NULL)
+    {
+        simd::float_4 stepSize;
+        simd::float_4 reciprocal;
+        // Usually every lane has the same depth, so there's only one entry to look up
+        if (simd::movemask(simd::float_4::cast(depth == simd::int32_4(depth[0]))) == 0xf)
+        {
+            stepSize = stepSizes[depth[0] - 1];
+            reciprocal = reciprocals[depth[0] - 1];
+        }
+        else
+        {
+            stepSize = simd::float_4(stepSizes[depth[0] - 1], stepSizes[depth[1] - 1], stepSizes[depth[2] - 1], stepSizes[depth[3] - 1]);
+            reciprocal = simd::float_4(reciprocals[depth[0] - 1], reciprocals[depth[1] - 1], reciprocals[depth[2] - 1], reciprocals[depth[3] - 1]);
+        }
+
+        // Clamp and offset so we're dealing with a number between 0v and the range
+        in = simd::clamp(in, -maxVolts, maxVolts) + maxVolts;
+        if (error)
+            in -= *error;
+        // Round halves up, as round() does for positive numbers
+        simd::float_4 out = simd::floor(in * reciprocal + dither + 0.5f) * stepSize;
+        if (error)
+            *error = out - in;
+        // Dither can round a step past either end
+        return simd::clamp(out - maxVolts, -maxVolts, maxVolts);
+    }
+};
+
+// SampleRateCrusher for 4 channels at once
+// Each lane's phase accumulates its target rate as a fraction of the engine rate, so it can hold for any length rather than a whole number of samples
+struct SampleRateCrusher4
+{
+    simd::float_4 out = 0.f;
+    simd::float_4 phase = 0.f;
+    simd::float_4 previous = 0.f;
+
+    // Delta is the target rate over the engine rate, above 0 and up to 1
+    void process(simd::float_4 delta, simd::float_4 in)
+    {
+        // At a delta of 1 every sample is taken as it is, whatever phase was left over from crushing
+        phase = simd::ifelse(delta >= 1.f, 1.f, phase + delta);
+        simd::float_4 sample = (phase >= 1.f);
+        phase -= sample & 1.f;
+        // The new sample falls between the last input and this one, the phase left over says how far back
+        simd::float_4 held = simd::crossfade(in, previous, phase / delta);
+        out = simd::ifelse(sample, held, out);
+        previous = in;
+    }
+};
+
 // Ramp generator based on Befaco Rampage
 // https://github.com/VCVRack/Befaco/blob/v1/src/Rampage.cpp
 struct Ramp
@@ -82,6 +439,12 @@ struct Ramp
     float out = 0.f;
     bool gate = false;
 
+    // Rise and fall times, only worked out again when their rates change
+    float riseRate = -1.f;
+    float fallRate = -1.f;
+    float riseTime = 0.f;
+    float fallTime = 0.f;
+
     float shapeDelta(float delta, float tau, float shape)
     {
         float lin = sgn(delta) * 10.f / tau;
@@ -116,9 +479,12 @@ struct Ramp
         {
             // Rise removed for now, just decay
             // Rise
-            float riseCv = riseRate;
-            float rise = minTime * pow(2.0, riseCv * 20.0);
-            out += shapeDelta(delta, rise, shape) * time;
+            if (riseRate != this->riseRate)
+            {
+                this->riseRate = riseRate;
+                riseTime = minTime * dsp::approxExp2_taylor5(riseRate * 20.f);
+            }
+            out += shapeDelta(delta, riseTime, shape) * time;
             rising = (in - out > 1e-3);
             if (!rising)
             {
@@ -129,10 +495,13 @@ struct Ramp
         {
             // Fall
             // Just control knob for now, will add CV control later
-            float fallCv = fallRate;
-            fallCv = clamp(fallCv, 0.0f, 1.0f);
-            float fall = minTime * pow(2.0f, fallCv * 20.0f);
-            out += shapeDelta(delta, fall, shape) * time;
+            if (fallRate != this->fallRate)
+            {
+                this->fallRate = fallRate;
+                float fallCv = clamp(fallRate, 0.0f, 1.0f);
+                fallTime = minTime * dsp::approxExp2_taylor5(fallCv * 20.0f);
+            }
+            out += shapeDelta(delta, fallTime, shape) * time;
             falling = (in - out < -1e-3);
             if (!falling)
             {
@@ -156,49 +525,187 @@ struct Ramp
     }
 };
 
-// Wavetable operator for FM synthesis
-struct Operator
+// Ramp for 4 voices at once, one per simd::float_4 lane
+// Works as Ramp does, gate is a lane mask and there's no end of cycle pulse
+// Rise and fall rates are set along with the gate, rather than passed in every sample
+struct Ramp4
 {
-    float phase = 0.f;
-    float freq = 0.f;
-    float wave = 0.f;
-    float out = 0.f;
-    float bufferSample1 = 0.f;
-    float bufferSample2 = 0.f;
-    float feedbackSample = 0.f;
+    float minTime = 1e-3;
+    simd::float_4 out = 0.f;
+    simd::float_4 gate = 0.f;
+
+    simd::float_4 riseTimes = 1e-3f;
+    simd::float_4 fallTimes = 1e-3f;
 
-    void setPitch(float pitch)
+    // Turns the gate on for one lane
+    void trigger(int lane)
     {
-        // The default pitch is C4 = 256.6256f
-        freq = dsp::FREQ_C4 * pow(2.f, pitch);
+        int32_t bits[4] = {};
+        bits[lane] = -1;
+        gate |= simd::float_4::cast(simd::int32_4::load(bits));
     }
 
-    void applyRatio(float ratio)
+    void setRates(int lane, float riseRate, float fallRate)
     {
-        freq *= ratio;
+        riseTimes[lane] = minTime * dsp::approxExp2_taylor5(riseRate * 20.f);
+        fallTimes[lane] = minTime * dsp::approxExp2_taylor5(clamp(fallRate, 0.f, 1.f) * 20.f);
+    }
+
+    simd::float_4 shapeDelta(simd::float_4 delta, simd::float_4 tau, float shape)
+    {
+        simd::float_4 lin = simd::sgn(delta) * 10.f / tau;
+        if (shape < 0.f)
+        {
+            simd::float_4 log = simd::sgn(delta) * 40.f / tau / (simd::fabs(delta) + 1.f);
+            return simd::crossfade(lin, log, -shape * 0.95f);
+        }
+        else
+        {
+            simd::float_4 exp = M_E * delta / tau;
+            return simd::crossfade(lin, exp, shape * 0.90f);
+        }
     }
 
-    void process(float time, float amplitude, float fmMod, float feedback, int table)
+    // Lanes outside active are left as they are
+    void process(float shape, float time, bool cycle, simd::float_4 active = simd::float_4::mask())
     {
-        phase += freq * time + fmMod * 0.5f;
-        if (phase >= 0.5f)
+        // Nothing moves once every lane has fallen back to 0 with its gate off
+        if (!simd::movemask((out != 0.f) | gate))
         {
-            phase -= 1.f;
+            return;
         }
-        else if (phase <= -0.5f)
+
+        simd::float_4 in = gate & 1.f;
+        simd::float_4 delta = in - out;
+
+        simd::float_4 risingLanes = (delta > 0.f);
+        simd::float_4 fallingLanes = (delta < 0.f);
+        simd::float_4 tau = simd::ifelse(risingLanes, riseTimes, fallTimes);
+
+        simd::float_4 newOut = out + (shapeDelta(delta, tau, shape) * time & (risingLanes | fallingLanes));
+        simd::float_4 rising = risingLanes & (in - newOut > 1e-3f);
+        simd::float_4 falling = fallingLanes & (in - newOut < -1e-3f);
+
+        // Gate goes off once the rise is done, or if we're already there
+        simd::float_4 newGate = gate & ((risingLanes & rising) | fallingLanes);
+        // End of cycle, check if we should turn the gate back on (cycle mode)
+        if (cycle)
+        {
+            newGate |= fallingLanes & ~falling;
+        }
+
+        newOut = simd::ifelse(rising | falling, newOut, in);
+
+        out = simd::ifelse(active, newOut, out);
+        gate = simd::ifelse(active, newGate, gate);
+    }
+};
+
+// Wavetable operator for FM synthesis
+// Runs 4 voices at once, one per simd::float_4 lane
+struct Operator
+{
+    simd::float_4 phase = 0.f;
+    simd::float_4 freq = 0.f;
+    simd::float_4 wave = 0.f;
+    simd::float_4 out = 0.f;
+    simd::float_4 bufferSample1 = 0.f;
+    simd::float_4 bufferSample2 = 0.f;
+    simd::float_4 feedbackSample = 0.f;
+
+    // Each lane's wavetable
+    const MipmappedWavetable *waveTables[4];
+
+    Operator()
+    {
+        for (int lane = 0; lane < 4; ++lane)
         {
-            phase += 1.f;
+            setTable(lane, 0);
         }
+    }
+
+    void setTable(int lane, int table)
+    {
+        waveTables[lane] = &opalMipmaps[table];
+    }
+
+    // Pitch is converted to Hz once for all 4 operators, see PSIOP::process()
+    void setFrequency(simd::float_4 frequency)
+    {
+        freq = frequency;
+    }
+
+    void applyRatio(simd::float_4 ratio)
+    {
+        freq *= ratio;
+    }
+
+    // Moves the phase on as process() would with no modulation, for voices that can't be heard
+    void advance(float time)
+    {
+        phase += freq * time;
+        phase -= simd::ifelse(phase >= 0.5f, 1.f, simd::ifelse(phase <= -0.5f, -1.f, 0.f));
+        out = 0.f;
+    }
+
+    // Only the first lanes voices are looked up, a lone voice skips the other three lanes' lookups altogether
+    void process(float time, simd::float_4 amplitude, simd::float_4 fmMod, simd::float_4 feedback, int lanes = 4)
+    {
+        simd::float_4 increment = freq * time + fmMod * 0.5f;
+        phase += increment;
+        phase -= simd::ifelse(phase >= 0.5f, 1.f, simd::ifelse(phase <= -0.5f, -1.f, 0.f));
 
-        float wtPOS = (phase + feedback * feedbackSample);
+        // Pick each lane's mip level from how far through the table it moves this sample
+        // floor(log2(8192 * increment)) straight from the exponent bits, see MipmappedWavetable
+        simd::int32_4 level = (simd::int32_4::cast(simd::fabs(increment) * 8192.f) >> 23) - 127;
+
+        simd::float_4 wtPOS = (phase + feedback * feedbackSample);
         // Wrap wavetable position between 0.f and 1.f
-        wtPOS = eucMod(wtPOS, 1.f);
+        wtPOS -= simd::floor(wtPOS);
 
-        float *waveTable = wavetable_opal[table];
-        float tableLength = wavetable_opal_lengths[table];
+        if (lanes == 1)
+        {
+            int k = clamp(level[0], 0, MipmappedWavetable::numLevels - 1);
+            const float *table = waveTables[0]->level(k);
+            int length = waveTables[0]->lengths[k];
+            float pos = wtPOS[0] * length;
+            int i = pos;
+            float frac = pos - i;
+            i -= i >= length ? length : 0;
+            int j = i + 1;
+            j -= j >= length ? length : 0;
+            wave = simd::float_4(table[i] + (table[j] - table[i]) * frac, 0.f, 0.f, 0.f);
+        }
+        else
+        {
+            const float *tables[4];
+            simd::float_4 tableLength;
+            for (int lane = 0; lane < 4; ++lane)
+            {
+                int k = clamp(level[lane], 0, MipmappedWavetable::numLevels - 1);
+                tables[lane] = waveTables[lane]->level(k);
+                tableLength[lane] = waveTables[lane]->lengths[k];
+            }
+
+            wtPOS *= tableLength;
+            simd::int32_4 wtIndex = wtPOS;
+            simd::float_4 wtFrac = wtPOS - simd::float_4(wtIndex);
 
-        wtPOS *= (tableLength);
-        wave = interpolateLinear(waveTable, wtPOS);
+            // Gather both points for each lane, wrapping round the end of the table
+            int i[4];
+            int j[4];
+            for (int lane = 0; lane < 4; ++lane)
+            {
+                int length = tableLength[lane];
+                i[lane] = wtIndex[lane];
+                i[lane] -= i[lane] >= length ? length : 0;
+                j[lane] = i[lane] + 1;
+                j[lane] -= j[lane] >= length ? length : 0;
+            }
+            simd::float_4 x0(tables[0][i[0]], tables[1][i[1]], tables[2][i[2]], tables[3][i[3]]);
+            simd::float_4 x1(tables[0][j[0]], tables[1][j[1]], tables[2][j[2]], tables[3][j[3]]);
+            wave = simd::crossfade(x0, x1, wtFrac);
+        }
 
         out = wave * amplitude;
 
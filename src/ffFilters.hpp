@@ -1,22 +1,50 @@
-struct DCBlock
+template <typename T = float>
+struct TDCBlock
 {
     // https://www.dsprelated.com/freebooks/filters/DC_Blocker.html
 
-    float xm1 = 0;
-    float ym1 = 0;
+    T xm1 = 0.f;
+    T ym1 = 0.f;
 
     float r = 0.995;
 
-    float process(float x)
+    // Keeps the cutoff at about 35Hz whatever the sample rate, which is where r = 0.995 puts it at 44.1kHz
+    void setSampleRate(float sampleRate)
     {
-        float y = x - xm1 + r * ym1;
+        r = std::exp(-2.f * float(M_PI) * 35.f / sampleRate);
+    }
+
+    T process(T x)
+    {
+        T y = x - xm1 + r * ym1;
         xm1 = x;
         ym1 = y;
         return y;
     }
 };
 
-struct ButterWorth2Filter : dsp::IIRFilter<3, 3>
+typedef TDCBlock<> DCBlock;
+
+// Two one-pole lowpasses in series (12dB/oct), cheap enough to move the cutoff every sample
+// The cutoff is a fraction of the sample rate, and w / (1 + w) stands in for the exact 1 - e^-w coefficient
+template <typename T = float>
+struct TOnePoleLowpass2
+{
+    T y1 = 0.f;
+    T y2 = 0.f;
+
+    T process(T x, T cutoff)
+    {
+        T w = 2.f * float(M_PI) * cutoff;
+        T a = w / (1.f + w);
+        y1 += a * (x - y1);
+        y2 += a * (y1 - y2);
+        return y2;
+    }
+};
+
+template <typename T = float>
+struct TButterWorth2Filter : dsp::IIRFilter<3, 3, T>
 {
     enum Type
     {
@@ -24,7 +52,7 @@ struct ButterWorth2Filter : dsp::IIRFilter<3, 3>
         HIGHPASS
     };
 
-    ButterWorth2Filter()
+    TButterWorth2Filter()
     {
         setParameters(LOWPASS, 0.f, 0.f);
     }
@@ -41,10 +69,16 @@ struct ButterWorth2Filter : dsp::IIRFilter<3, 3>
     {
         // fn: normalised frequency
         float fn = fc / fs;
-        // Used in HPF
-        float K = std::tan(M_PI * fn);
+        setParameters(type, T(std::tan(M_PI * fn)));
+    }
+
+    /** As above, with K = tan(pi * fc / fs) already worked out
+    Lets a low and high pass pair share one tan()
+    */
+    void setParameters(int type, T K)
+    {
         // Used in LPF
-        float C = 1 / K;
+        T C = 1 / K;
 
         // Note - Pirkle uses a0... for the x coefficients, b0 for the y coefficients.
         // Rack API is switched
@@ -72,6 +106,8 @@ struct ButterWorth2Filter : dsp::IIRFilter<3, 3>
     }
 };
 
+typedef TButterWorth2Filter<> ButterWorth2Filter;
+
 struct LinkwitzRiley2Filter : dsp::IIRFilter<3, 3>
 {
     enum Type
@@ -126,7 +162,51 @@ struct LinkwitzRiley2Filter : dsp::IIRFilter<3, 3>
     }
 };
 
-struct LinkwitzRiley4Filter
+template <typename T = float>
+struct TLinkwitzRiley4Coefficients
+{
+    /** Coefficients for a LinkwitzRiley4Filter
+    Only recalculated when the cutoff moves by more than a small fraction, so a static crossover never calls tan()
+    Several filters can share one set, eg polyphonic channels that all see the same cutoff
+    With T = simd::float_4 each lane holds one channel, and all 4 lanes are worked out together
+    */
+
+    // Relative change in cutoff we ignore, 0.05% is well under a cent
+    static constexpr float tolerance = 5e-4f;
+
+    TButterWorth2Filter<T> lowpass;
+    TButterWorth2Filter<T> highpass;
+    T fc = -1.f;
+    float fs = -1.f;
+    // Bumped whenever the coefficients change, so filters know when to copy them
+    int version = 0;
+
+    void setParameters(T fc, float fs)
+    {
+        auto moved = simd::fabs(fc - this->fc) > tolerance * this->fc;
+        if (fs == this->fs)
+        {
+            if (!simd::movemask(moved))
+            {
+                return;
+            }
+            // Lanes that haven't moved keep their old cutoff
+            fc = simd::ifelse(moved, fc, this->fc);
+        }
+        this->fc = fc;
+        this->fs = fs;
+
+        T K = simd::tan(float(M_PI / fs) * fc);
+        lowpass.setParameters(TButterWorth2Filter<T>::LOWPASS, K);
+        highpass.setParameters(TButterWorth2Filter<T>::HIGHPASS, K);
+        ++version;
+    }
+};
+
+typedef TLinkwitzRiley4Coefficients<> LinkwitzRiley4Coefficients;
+
+template <typename T = float>
+struct TLinkwitzRiley4Filter
 {
     /** 24 dB/Oct 4th order LR filter
 	Built from 2 cascaded 2nd order BW Filters
@@ -134,23 +214,157 @@ struct LinkwitzRiley4Filter
 	*/
 
     // 0,2: LPF, 1,3: HPF
-    ButterWorth2Filter butterWorth[4];
-    float outs[2] = {};
+    TButterWorth2Filter<T> butterWorth[4];
+    T outs[2] = {};
+
+    // Coefficients used when the cutoff is passed straight to process()
+    TLinkwitzRiley4Coefficients<T> coefficients;
+
+    // The coefficients the stages currently hold
+    const TLinkwitzRiley4Coefficients<T> *source = nullptr;
+    int sourceVersion = -1;
+
+    void process(T input, T fc, float fs)
+    {
+        coefficients.setParameters(fc, fs);
+        process(input, coefficients);
+    }
 
-    void process(float input, float fc, float fs)
+    void process(T input, const TLinkwitzRiley4Coefficients<T> &coeffs)
     {
+        // Only copy coefficients into the stages when they've changed
+        if (&coeffs != source || coeffs.version != sourceVersion)
+        {
+            for (int i = 0; i < 4; i += 2)
+            {
+                butterWorth[i].setCoefficients(coeffs.lowpass.b, coeffs.lowpass.a);
+                butterWorth[i + 1].setCoefficients(coeffs.highpass.b, coeffs.highpass.a);
+            }
+            source = &coeffs;
+            sourceVersion = coeffs.version;
+        }
+
         // First Stage
-        butterWorth[0].setParameters(0, fc, fs);
         outs[0] = butterWorth[0].process(input);
-
-        butterWorth[1].setParameters(1, fc, fs);
         outs[1] = butterWorth[1].process(input);
 
         // Second Stage
-        butterWorth[2].setParameters(0, fc, fs);
         outs[0] = butterWorth[2].process(outs[0]);
-
-        butterWorth[3].setParameters(1, fc, fs);
         outs[1] = butterWorth[3].process(outs[1]);
     }
 };
+
+typedef TLinkwitzRiley4Filter<> LinkwitzRiley4Filter;
+
+/** Half-band lowpass that decimates by 2, done the polyphase way
+Every other tap of a half-band filter is 0 apart from the centre one, so only the odd input samples go through the FIR,
+and the even ones just need delaying to line up with the centre tap
+K is the number of non-zero taps either side of the centre, so there are 4K - 1 taps in all
+*/
+template <int K, typename T = float>
+struct THalfBandDecimator
+{
+    // Taps 1, 3, 5... away from the centre
+    float coefficients[K];
+
+    // Odd samples, stored twice so the last 2K are always in a row from position
+    T odd[4 * K];
+    T even[K];
+    int position = 0;
+    int evenPosition = 0;
+
+    THalfBandDecimator()
+    {
+        // Blackman windowed sinc, scaled for unity gain at DC
+        float sum = 0.f;
+        for (int j = 0; j < K; ++j)
+        {
+            float d = 2 * j + 1;
+            float window = 0.42f + 0.5f * std::cos(M_PI * d / (2 * K)) + 0.08f * std::cos(2 * M_PI * d / (2 * K));
+            coefficients[j] = std::sin(M_PI * d / 2) / (M_PI * d) * window;
+            sum += 2.f * coefficients[j];
+        }
+        for (int j = 0; j < K; ++j)
+        {
+            coefficients[j] *= 0.5f / sum;
+        }
+        reset();
+    }
+
+    void reset()
+    {
+        for (int i = 0; i < 4 * K; ++i)
+        {
+            odd[i] = 0.f;
+        }
+        for (int i = 0; i < K; ++i)
+        {
+            even[i] = 0.f;
+        }
+    }
+
+    // Takes two samples at the higher rate and returns one at the lower
+    T process(T x0, T x1)
+    {
+        position = (position == 0 ? 2 * K : position) - 1;
+        odd[position] = x1;
+        odd[position + 2 * K] = x1;
+        const T *history = &odd[position];
+
+        even[evenPosition] = x0;
+        evenPosition = (evenPosition + 1 == K) ? 0 : evenPosition + 1;
+
+        // Taps either side of the centre share a coefficient
+        T y = 0.5f * even[evenPosition];
+        for (int j = 0; j < K; ++j)
+        {
+            y += coefficients[j] * (history[K - 1 - j] + history[K + j]);
+        }
+        return y;
+    }
+};
+
+/** Brings a signal oversampled 2x, 4x or 8x back down, one half-band stage per octave
+Only the last stage's transition band lands anywhere near the audio band, so it gets the most taps,
+the earlier ones just have to clear whatever would fold down into it
+*/
+template <typename T = float>
+struct TOversamplingDecimator
+{
+    THalfBandDecimator<4, T> stage8;
+    THalfBandDecimator<5, T> stage4;
+    THalfBandDecimator<12, T> stage2;
+
+    void reset()
+    {
+        stage8.reset();
+        stage4.reset();
+        stage2.reset();
+    }
+
+    // Takes factor samples from in, which is used as scratch space
+    T process(T *in, int factor)
+    {
+        if (factor >= 8)
+        {
+            for (int i = 0; i < 4; ++i)
+            {
+                in[i] = stage8.process(in[2 * i], in[2 * i + 1]);
+            }
+        }
+        if (factor >= 4)
+        {
+            for (int i = 0; i < 2; ++i)
+            {
+                in[i] = stage4.process(in[2 * i], in[2 * i + 1]);
+            }
+        }
+        if (factor >= 2)
+        {
+            return stage2.process(in[0], in[1]);
+        }
+        return in[0];
+    }
+};
+
+typedef TOversamplingDecimator<> OversamplingDecimator;
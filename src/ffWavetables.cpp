@@ -0,0 +1,67 @@
+#include "ffWavetables.hpp"
+// The raw tables are only included here, so the plugin carries a single copy of them
+#include "wavetables/Wavetables.hpp"
+
+MipmappedWavetable opalMipmaps[WAVETABLE_OPAL_NUM];
+
+void MipmappedWavetable::build(const float *table, int length)
+{
+    // Spectrum of the whole table
+    std::vector<float> spectrum(length);
+    dsp::RealFFT fft(length);
+    fft.rfft(table, spectrum.data());
+
+    // Level 0 is the original table
+    levels[0] = table;
+    lengths[0] = length;
+
+    int offsets[numLevels] = {};
+    int total = 0;
+    for (int k = 1; k < numLevels; ++k)
+    {
+        // Keep each level's harmonics well under its own Nyquist, so linear interpolation stays clean
+        int harmonics = (length / 2) >> k;
+        lengths[k] = clamp(4 * harmonics, 64, length);
+        offsets[k] = total;
+        total += lengths[k];
+    }
+    samples.resize(total);
+    for (int k = 1; k < numLevels; ++k)
+    {
+        levels[k] = &samples[offsets[k]];
+    }
+
+    std::vector<float> levelSpectrum;
+    for (int k = 1; k < numLevels; ++k)
+    {
+        int harmonics = (length / 2) >> k;
+        int levelLength = lengths[k];
+
+        // Harmonics above the limit are dropped, as is the level's own Nyquist bin
+        levelSpectrum.assign(levelLength, 0.f);
+        levelSpectrum[0] = spectrum[0];
+        for (int h = 1; h <= harmonics && h < levelLength / 2; ++h)
+        {
+            levelSpectrum[2 * h] = spectrum[2 * h];
+            levelSpectrum[2 * h + 1] = spectrum[2 * h + 1];
+        }
+
+        dsp::RealFFT levelFft(levelLength);
+        float *out = &samples[offsets[k]];
+        levelFft.irfft(levelSpectrum.data(), out);
+
+        // The inverse isn't normalised, and the spectrum came from the full length table
+        for (int i = 0; i < levelLength; ++i)
+        {
+            out[i] /= length;
+        }
+    }
+}
+
+void initWavetables()
+{
+    for (int i = 0; i < WAVETABLE_OPAL_NUM; ++i)
+    {
+        opalMipmaps[i].build(wavetable_opal[i], wavetable_opal_lengths[i]);
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "plugin.hpp"
+
+// Band-limited copies of a wavetable, one per octave
+// Level 0 is the table as it is, each level after that has half the harmonics of the one before
+// So level k can be played 2^k times faster than level 0 before it aliases
+struct MipmappedWavetable
+{
+    static const int numLevels = 12;
+
+    // Levels 1 onwards end to end, level 0 points straight at the original table
+    std::vector<float> samples;
+    const float *levels[numLevels] = {};
+    int lengths[numLevels] = {};
+
+    void build(const float *table, int length);
+
+    const float *level(int k) const
+    {
+        return levels[k];
+    }
+};
+
+// The opal tables used by PSIOP, built when the plugin is loaded
+extern MipmappedWavetable opalMipmaps[];
+
+void initWavetables();
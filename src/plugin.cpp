@@ -1,4 +1,5 @@
 #include "plugin.hpp"
+#include "ffWavetables.hpp"
 
 Plugin *pluginInstance;
 
@@ -23,6 +24,9 @@ void init(Plugin *p)
 	p->addModel(modelBotzinger);
 	p->addModel(modelShaney);
 
+	// Band-limited wavetables for PSIOP
+	initWavetables();
+
 	// Any other plugin initialization may go here.
 	// As an alternative, consider lazy-loading assets and lookup tables when your module is created to reduce startup times of Rack.
 }
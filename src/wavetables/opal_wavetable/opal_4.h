@@ -2,8 +2,8 @@
 #define WAVETABLE_OPAL_4_H
 #define WAVETABLE_OPAL_4_LENGTH 4096
 
-static long opal_4_tableLength = 4096;
-static float opal_4_waveTable[WAVETABLE_OPAL_4_LENGTH] = {
+static const long opal_4_tableLength = 4096;
+static const float opal_4_waveTable[WAVETABLE_OPAL_4_LENGTH] = {
     0.000000e+00, 1.533866e-03, 3.067851e-03, 4.601836e-03, 6.135821e-03, 7.669806e-03, 9.203672e-03, 1.073766e-02, 1.227152e-02, 1.380527e-02, 1.533914e-02, 1.687288e-02, 1.840663e-02, 1.994038e-02, 2.147400e-02, 2.300763e-02, 
     2.454114e-02, 2.607465e-02, 2.760804e-02, 2.914143e-02, 3.067470e-02, 3.220797e-02, 3.374112e-02, 3.527415e-02, 3.680718e-02, 3.834009e-02, 3.987288e-02, 4.140556e-02, 4.293823e-02, 4.447067e-02, 4.600310e-02, 4.753542e-02, 
     4.906762e-02, 5.059969e-02, 5.213165e-02, 5.366349e-02, 5.519521e-02, 5.672681e-02, 5.825818e-02, 5.978954e-02, 6.132066e-02, 6.285167e-02, 6.438255e-02, 6.591332e-02, 6.744385e-02, 6.897426e-02, 7.050455e-02, 7.203460e-02, 
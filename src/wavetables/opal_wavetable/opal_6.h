@@ -2,8 +2,8 @@
 #define WAVETABLE_OPAL_6_H
 #define WAVETABLE_OPAL_6_LENGTH 4096
 
-static long opal_6_tableLength = 4096;
-static float opal_6_waveTable[WAVETABLE_OPAL_6_LENGTH] = {
+static const long opal_6_tableLength = 4096;
+static const float opal_6_waveTable[WAVETABLE_OPAL_6_LENGTH] = {
     0.000000e+00, 3.067851e-03, 6.135821e-03, 9.203672e-03, 1.227152e-02, 1.533914e-02, 1.840663e-02, 2.147400e-02, 2.454114e-02, 2.760804e-02, 3.067470e-02, 3.374112e-02, 3.680718e-02, 3.987288e-02, 4.293823e-02, 4.600310e-02, 
     4.906762e-02, 5.213165e-02, 5.519521e-02, 5.825818e-02, 6.132066e-02, 6.438255e-02, 6.744385e-02, 7.050455e-02, 7.356453e-02, 7.662380e-02, 7.968235e-02, 8.274019e-02, 8.579731e-02, 8.885348e-02, 9.190893e-02, 9.496343e-02, 
     9.801710e-02, 1.010698e-01, 1.041216e-01, 1.071724e-01, 1.102221e-01, 1.132709e-01, 1.163186e-01, 1.193651e-01, 1.224107e-01, 1.254549e-01, 1.284981e-01, 1.315399e-01, 1.345806e-01, 1.376201e-01, 1.406581e-01, 1.436950e-01, 
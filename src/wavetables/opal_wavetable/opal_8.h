@@ -2,8 +2,8 @@
 #define WAVETABLE_OPAL_8_H
 #define WAVETABLE_OPAL_8_LENGTH 4096
 
-static long opal_8_tableLength = 4096;
-static float opal_8_waveTable[WAVETABLE_OPAL_8_LENGTH] = {
+static const long opal_8_tableLength = 4096;
+static const float opal_8_waveTable[WAVETABLE_OPAL_8_LENGTH] = {
     9.999999e-01, 9.990234e-01, 9.980474e-01, 9.970717e-01, 9.960966e-01, 9.951220e-01, 9.941478e-01, 9.931741e-01, 9.922009e-01, 9.912281e-01, 9.902558e-01, 9.892840e-01, 9.883127e-01, 9.873419e-01, 9.863715e-01, 9.854016e-01, 
     9.844322e-01, 9.834633e-01, 9.824948e-01, 9.815269e-01, 9.805593e-01, 9.795923e-01, 9.786258e-01, 9.776597e-01, 9.766941e-01, 9.757290e-01, 9.747643e-01, 9.738002e-01, 9.728365e-01, 9.718733e-01, 9.709105e-01, 9.699483e-01, 
     9.689865e-01, 9.680253e-01, 9.670645e-01, 9.661041e-01, 9.651443e-01, 9.641849e-01, 9.632260e-01, 9.622675e-01, 9.613096e-01, 9.603521e-01, 9.593951e-01, 9.584385e-01, 9.574825e-01, 9.565269e-01, 9.555719e-01, 9.546173e-01, 
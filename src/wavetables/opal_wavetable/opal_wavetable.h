@@ -11,7 +11,7 @@
 #include "opal_7.h"
 #include "opal_8.h"
 
-static float* wavetable_opal[WAVETABLE_OPAL_NUM] = {
+static const float *const wavetable_opal[WAVETABLE_OPAL_NUM] = {
     opal_1_waveTable,
     opal_2_waveTable,
     opal_3_waveTable,
@@ -22,7 +22,7 @@ static float* wavetable_opal[WAVETABLE_OPAL_NUM] = {
     opal_8_waveTable
 };
 
-static long wavetable_opal_lengths[WAVETABLE_OPAL_NUM] = {
+static const long wavetable_opal_lengths[WAVETABLE_OPAL_NUM] = {
     opal_1_tableLength,
     opal_2_tableLength,
     opal_3_tableLength,